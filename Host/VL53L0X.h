@@ -0,0 +1,16 @@
+/****************************************************************************
+* Host stand-in for the VL53L0X driver header, for Host/sim_plant.c.
+*
+* The simulated sensor only keeps the range of the last sample, the
+* simulator implements VL53L0X_readRangeContinuousMillimetersDMA on it.
+****************************************************************************/
+#ifndef VL53L0X_H
+#define VL53L0X_H
+
+#include <stdint.h>
+
+struct VL53L0X {
+    uint16_t range; /* latched by the data-ready interrupt */
+};
+
+#endif /* VL53L0X_H */
@@ -0,0 +1,265 @@
+/****************************************************************************
+* Aperiodic response time percentiles under EDF, per server policy.
+*
+* A workload generator: two periodic tasks, C=10/T=20 and C=8/T=40 (U = 0.7),
+* and a server of C_s=3, T_s=10 (U_s = 0.3), so U = 1.0. Aperiodic jobs
+* arrive at random, on average every BENCH_MEAN_ARRIVAL ticks, with a
+* declared cost of 1 to BENCH_MAX_COST ticks. A given percentage of the
+* jobs overruns and executes twice its declared cost, which the Total
+* Bandwidth Server trusts and the Constant Bandwidth Server enforces.
+* Every job "executes" by raising the virtual tick itself and
+* SysTick_Handler charges each tick to the thread that ran in it, like
+* Host/bench_server.c. The program prints the 50th, 90th and 99th
+* percentile and the worst response time of the aperiodic jobs and the
+* deadline misses of the periodic tasks.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX -DMIROS_EDF -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_bandwidth.c \
+*       -o bench_bandwidth
+*
+* usage: bench_bandwidth [bs|ps|ds|tbs|cbs] [ticks] [overrun %]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_deadline.h"
+#include "miros_server.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_JOBS 8U            /* aperiodic jobs in flight at most */
+#define BENCH_MEAN_ARRIVAL 10U   /* ticks */
+#define BENCH_MAX_COST 3U        /* declared, ticks */
+#define BENCH_SERVER_CAPACITY 3U
+#define BENCH_SERVER_PERIOD 10U
+#define BENCH_MAX_SAMPLES (1U << 20)
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+    OSThread_periodics_task_parameters parameters;
+    uint32_t cost;     /* ticks of execution per job */
+    uint32_t period;
+    uint32_t executed; /* ticks charged to the current job */
+    uint32_t release;  /* aperiodic: arrival tick */
+    int busy;          /* aperiodic: queued or running */
+} bench_task;
+
+static bench_task periodics[] = {
+    { .cost = 8U, .period = 40U },
+    { .cost = 10U, .period = 20U },
+};
+static bench_task aperiodics[BENCH_JOBS];
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static uint32_t bench_ticks = 200000U;
+static uint32_t bench_overrun = 0U; /* percent of the jobs */
+static uint32_t uwTick;
+static uint32_t next_arrival = 1U;
+static uint32_t dropped;
+static uint32_t responses[BENCH_MAX_SAMPLES];
+static uint32_t samples;
+static char const *mode = "bs";
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+static uint32_t bench_rand(void) {
+    static uint32_t state = 2463534242U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static int bench_compare(void const *a, void const *b) {
+    uint32_t x = *(uint32_t const *)a;
+    uint32_t y = *(uint32_t const *)b;
+    return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of the sorted responses */
+static uint32_t bench_percentile(uint32_t p) {
+    uint32_t rank = (p * samples + 99U) / 100U;
+    return responses[(rank != 0U) ? (rank - 1U) : 0U];
+}
+
+static void bench_report(void) {
+    uint32_t misses = 0U;
+
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        misses += OS_deadline_stats_get(&periodics[i].TCB_thread)->misses;
+    }
+    if (samples == 0U) {
+        printf("%s: no aperiodic job completed\n", mode);
+        exit(0);
+    }
+    qsort(responses, samples, sizeof(responses[0]), &bench_compare);
+    printf("%-3s: %u jobs (%u%% overrun), response p50 %u p90 %u p99 %u"
+           " max %u ticks, %u dropped, %u periodic deadline misses\n",
+           mode, (unsigned)samples, (unsigned)bench_overrun,
+           (unsigned)bench_percentile(50U), (unsigned)bench_percentile(90U),
+           (unsigned)bench_percentile(99U), (unsigned)responses[samples - 1U],
+           (unsigned)dropped, (unsigned)misses);
+    exit(0);
+}
+
+static void aperiodic(void);
+
+/* a new aperiodic job every BENCH_MEAN_ARRIVAL ticks on average */
+static void bench_arrival(void) {
+    while (next_arrival <= uwTick) {
+        bench_task *t = (bench_task *)0;
+
+        /* a job that just finished still runs until the switch away */
+        for (unsigned i = 0U; i < BENCH_JOBS; ++i) {
+            if (!aperiodics[i].busy && (OS_curr != &aperiodics[i].TCB_thread)) {
+                t = &aperiodics[i];
+                break;
+            }
+        }
+        if (t == (bench_task *)0) {
+            ++dropped;
+        } else {
+            uint32_t declared = 1U + bench_rand() % BENCH_MAX_COST;
+
+            t->busy = 1;
+            t->cost = declared;
+            if (bench_rand() % 100U < bench_overrun) {
+                t->cost = 2U * declared;
+            }
+            t->executed = 0U;
+            t->release = uwTick;
+            OSAperiodic_job_start(&t->TCB_thread, &aperiodic,
+                                  t->stack_thread, sizeof(t->stack_thread),
+                                  declared);
+        }
+        next_arrival += 1U + bench_rand() % (2U * BENCH_MEAN_ARRIVAL - 1U);
+    }
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+
+    /* charge the elapsed tick to the job that ran in it */
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        if (OS_curr == &periodics[i].TCB_thread) {
+            ++periodics[i].executed;
+        }
+    }
+    for (unsigned i = 0U; i < BENCH_JOBS; ++i) {
+        if (OS_curr == &aperiodics[i].TCB_thread) {
+            ++aperiodics[i].executed;
+        }
+    }
+
+    OS_tick();
+    bench_arrival();
+
+    if (uwTick >= bench_ticks) {
+        bench_report();
+    }
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+void OS_onIdle(void) {
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+/* run until the job has one tick left, the last one is taken when it ends */
+static void bench_execute(bench_task *me) {
+    while (me->executed + 1U < me->cost) {
+        OS_port_tick(); /* run for one tick */
+    }
+    __disable_irq();
+    OS_port_tick();
+}
+
+static void aperiodic(void) {
+    bench_task *me = (bench_task *)0;
+
+    for (unsigned i = 0U; i < BENCH_JOBS; ++i) {
+        if (OS_curr == &aperiodics[i].TCB_thread) {
+            me = &aperiodics[i];
+        }
+    }
+    Q_ASSERT(me != (bench_task *)0);
+
+    bench_execute(me);
+    if (samples < BENCH_MAX_SAMPLES) {
+        responses[samples++] = HAL_GetTick() + 1U - me->release;
+    }
+    me->busy = 0;
+    OS_finished_aperiodic_task();
+}
+
+static void bench_job(bench_task *me) {
+    while (1) {
+        me->executed = 0U;
+        bench_execute(me);
+        OS_wait_next_period();
+    }
+}
+
+static void job0(void) { bench_job(&periodics[0]); }
+static void job1(void) { bench_job(&periodics[1]); }
+
+int main(int argc, char *argv[]) {
+    static OSThreadHandler const handlers[] = { &job0, &job1 };
+    static char const *const modes[] = { "bs", "ps", "ds", "tbs", "cbs" };
+    OS_server_policy policy = OS_SERVER_BACKGROUND;
+
+    if (argc > 1) {
+        mode = argv[1];
+    }
+    for (unsigned i = 0U; i < Q_DIM(modes); ++i) {
+        if (strcmp(mode, modes[i]) == 0) {
+            policy = (OS_server_policy)i;
+        }
+    }
+    mode = modes[policy];
+    if (argc > 2) {
+        bench_ticks = (uint32_t)strtoul(argv[2], (char **)0, 10);
+    }
+    if (argc > 3) {
+        bench_overrun = (uint32_t)strtoul(argv[3], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        bench_task *t = &periodics[i];
+        t->parameters.period_absolute = t->period;
+        t->parameters.deadline_absolute = t->period;
+        t->parameters.period_dinamic = t->period;
+        t->parameters.deadline_dinamic = t->period;
+        t->TCB_thread.task_parameters = &t->parameters;
+        OSPeriodic_task_start(&t->TCB_thread, handlers[i],
+                              t->stack_thread, sizeof(t->stack_thread));
+    }
+    OS_server_start(policy, BENCH_SERVER_CAPACITY, BENCH_SERVER_PERIOD);
+    OS_run();
+}
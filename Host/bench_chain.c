@@ -0,0 +1,226 @@
+/****************************************************************************
+* Input-to-output latency of the sensor -> PID -> PWM pipeline, released
+* independently versus as a task chain.
+*
+* Three tasks with the structure of main.c, period BENCH_PERIOD ticks:
+*   - sensor : C=1, samples the input at the start of its job
+*   - pid    : C=2, reads the last sample and writes an output
+*   - pwm    : C=1, applies the last output
+* The sample carries the tick it was taken on, through the PID output, up
+* to the completion of the pwm job. Every job "executes" by raising the
+* virtual tick itself and SysTick_Handler charges each tick to the thread
+* that ran in it, like Host/bench_bandwidth.c.
+*   - free  : three periodic tasks released on the same tick; RM breaks the
+*             tie by start order, which puts pwm first and sensor last
+*   - chain : sensor is periodic, pid and pwm are sporadic tasks linked
+*             with OS_chain_link()
+* The program prints the latency measured by the tasks and, in chain mode,
+* the one measured by the kernel (OS_chain_stats_get, and
+* OS_chain_trace_get with -DMIROS_TRACE).
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_EDF] [-DMIROS_TRACE] -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_chain.c -o bench_chain
+*
+* usage: bench_chain [free|chain] [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_sporadic.h"
+#include "miros_channel.h"
+#include "miros_chain.h"
+#include "miros_trace.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_PERIOD 10U
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+    OSThread_periodics_task_parameters parameters;
+    uint32_t cost;     /* ticks of execution per job */
+    uint32_t executed; /* ticks charged to the current job */
+} bench_task;
+
+enum { SENSOR, PID, PWM };
+
+static bench_task tasks[] = {
+    { .cost = 1U }, /* sensor */
+    { .cost = 2U }, /* pid */
+    { .cost = 1U }, /* pwm */
+};
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static channel_t channel_sample; /* sensor -> pid, the sampling tick */
+static channel_t channel_output; /* pid -> pwm, the same tick */
+
+static uint32_t bench_ticks = 100000U;
+static uint32_t uwTick;
+static int chained;
+static uint32_t samples;
+static uint32_t latency_min;
+static uint32_t latency_max;
+static uint64_t latency_sum;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+static void bench_report(void) {
+    printf("%-5s: %u outputs, input-to-output latency min %u mean %.2f max %u ticks\n",
+           chained ? "chain" : "free", (unsigned)samples, (unsigned)latency_min,
+           (samples != 0U) ? (double)latency_sum / (double)samples : 0.0,
+           (unsigned)latency_max);
+    if (chained) {
+        OS_chain_stats const *stats = OS_chain_stats_get(&tasks[PWM].TCB_thread);
+
+        Q_ASSERT(stats != (OS_chain_stats *)0);
+        printf("kernel: %u chains, latency min %u max %u last %u ticks\n",
+               (unsigned)stats->count, (unsigned)stats->latency_min,
+               (unsigned)stats->latency_max, (unsigned)stats->latency_last);
+#ifdef MIROS_TRACE
+        OS_trace_stat const *trace = OS_chain_trace_get(&tasks[PWM].TCB_thread);
+
+        printf("kernel: latency min %u mean %.1f max %u ns\n",
+               (unsigned)trace->min, (double)trace->sum / (double)trace->count,
+               (unsigned)trace->max);
+#endif
+    }
+    exit(0);
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+
+    /* charge the elapsed tick to the job that ran in it */
+    for (unsigned i = 0U; i < Q_DIM(tasks); ++i) {
+        if (OS_curr == &tasks[i].TCB_thread) {
+            ++tasks[i].executed;
+        }
+    }
+
+    OS_tick();
+
+    if (uwTick >= bench_ticks) {
+        bench_report();
+    }
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+void OS_onIdle(void) {
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+/* run until the job has one tick left, the last one is taken when it ends */
+static void bench_execute(bench_task *me) {
+    me->executed = 0U;
+    while (me->executed + 1U < me->cost) {
+        OS_port_tick(); /* run for one tick */
+    }
+    __disable_irq();
+    OS_port_tick();
+}
+
+static void sensor(void) {
+    while (1) {
+        uint32_t taken = uwTick;
+
+        bench_execute(&tasks[SENSOR]);
+        channel_write(&channel_sample, &taken);
+        OS_wait_next_period();
+    }
+}
+
+static void pid(void) {
+    while (1) {
+        uint32_t taken;
+
+        bench_execute(&tasks[PID]);
+        if (channel_read(&channel_sample, &taken) != 0U) {
+            channel_write(&channel_output, &taken);
+        }
+        OS_wait_next_period();
+    }
+}
+
+static void pwm(void) {
+    while (1) {
+        uint32_t taken;
+
+        bench_execute(&tasks[PWM]);
+        if (channel_read(&channel_output, &taken) != 0U) {
+            /* completes in the tick after uwTick, rounded up */
+            uint32_t latency = uwTick + 1U - taken;
+
+            if ((samples == 0U) || (latency < latency_min)) {
+                latency_min = latency;
+            }
+            if (latency > latency_max) {
+                latency_max = latency;
+            }
+            latency_sum += latency;
+            ++samples;
+        }
+        OS_wait_next_period();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static OSThreadHandler const handlers[] = { &sensor, &pid, &pwm };
+
+    if (argc > 1) {
+        chained = (strcmp(argv[1], "chain") == 0);
+    }
+    if (argc > 2) {
+        bench_ticks = (uint32_t)strtoul(argv[2], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    channel_init(&channel_sample, sizeof(uint32_t));
+    channel_init(&channel_output, sizeof(uint32_t));
+
+    for (unsigned i = 0U; i < Q_DIM(tasks); ++i) {
+        bench_task *t = &tasks[i];
+        t->parameters.period_absolute = BENCH_PERIOD;
+        t->parameters.deadline_absolute = BENCH_PERIOD;
+        t->parameters.period_dinamic = BENCH_PERIOD;
+        t->parameters.deadline_dinamic = BENCH_PERIOD;
+        t->TCB_thread.task_parameters = &t->parameters;
+        if (chained && (i != SENSOR)) {
+            OSSporadic_task_start(&t->TCB_thread, handlers[i],
+                                  t->stack_thread, sizeof(t->stack_thread));
+        } else {
+            OSPeriodic_task_start(&t->TCB_thread, handlers[i],
+                                  t->stack_thread, sizeof(t->stack_thread));
+        }
+    }
+    if (chained) {
+        OS_chain_link(&tasks[SENSOR].TCB_thread, &tasks[PID].TCB_thread);
+        OS_chain_link(&tasks[PID].TCB_thread, &tasks[PWM].TCB_thread);
+    }
+    OS_run();
+}
@@ -0,0 +1,207 @@
+/****************************************************************************
+* Lock-free channel versus mutex for one sample, and a torn read check.
+*
+* First the low task times BENCH_SAMPLES samples passed through a
+* mutex_t (lock, copy, unlock on each side, as main.c did for
+* currentDistance and pwmVal) and through a channel_t, in host ns per
+* sample written and read. The mutex figure is time spent with interrupts
+* disabled or at the ceiling, the channel figure is not.
+*
+* Then SysTick is started from SIGALRM at BENCH_TICKS_PER_SEC, so the two
+* tasks preempt each other at arbitrary instructions:
+*   - high : C < 1 tick, T = 1 tick, reads channel "down" and writes "up"
+*   - low  : spins writing "down" and reading "up"
+* Every message is {n, ~n}, where n is the message number that
+* channel_read() returns; a read that does not match is a torn read. The
+* program exits with status 1 if it saw one.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_channel.c \
+*       -o bench_channel
+*
+* usage: bench_channel [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_ceiling.h"
+#include "miros_channel.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_SAMPLES 10000000U
+#define BENCH_TICKS_PER_SEC 20000U
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+    OSThread_periodics_task_parameters parameters;
+} bench_task;
+
+typedef struct {
+    uint32_t number;
+    uint32_t check; /* ~number */
+} bench_msg;
+
+static bench_task task_high;
+static bench_task task_low;
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static mutex_t mutex_sample;
+static channel_t channel_sample;
+static channel_t channel_down; /* low -> high */
+static channel_t channel_up;   /* high -> low */
+
+static volatile uint32_t uwTick;
+static uint32_t bench_ticks = 20000U;
+static uint32_t reads_high;
+static uint32_t reads_low;
+static uint32_t torn;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+    OS_tick();
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+void OS_onIdle(void) {
+    pause(); /* wait for SIGALRM */
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_write(channel_t *ch, uint32_t *written) {
+    bench_msg msg;
+
+    msg.number = ++*written;
+    msg.check = ~msg.number;
+    channel_write(ch, &msg);
+}
+
+static void bench_read(channel_t *ch, uint32_t *reads) {
+    bench_msg msg;
+    uint32_t number = channel_read(ch, &msg);
+
+    if ((number != 0U)
+        && ((msg.number != number) || (msg.check != ~number))) {
+        ++torn;
+    }
+    ++*reads;
+}
+
+/* ns per sample written and read, with both sides in the same task */
+static void bench_cost(void) {
+    volatile int sample = 0;
+    int copy;
+    uint64_t start;
+    double mutex, channel;
+
+    start = bench_ns();
+    for (uint32_t n = 0U; n < BENCH_SAMPLES; ++n) {
+        mutex_lock(&mutex_sample);
+        copy = (int)n;
+        sample = copy;
+        mutex_unlock(&mutex_sample);
+
+        mutex_lock(&mutex_sample);
+        copy = sample;
+        mutex_unlock(&mutex_sample);
+    }
+    mutex = (double)(bench_ns() - start) / (double)BENCH_SAMPLES;
+
+    start = bench_ns();
+    for (uint32_t n = 0U; n < BENCH_SAMPLES; ++n) {
+        copy = (int)n;
+        channel_write(&channel_sample, &copy);
+        channel_read(&channel_sample, &copy);
+    }
+    channel = (double)(bench_ns() - start) / (double)BENCH_SAMPLES;
+
+    printf("per sample: mutex %.1f ns (masked or at the ceiling), "
+           "channel %.1f ns (preemptible)\n", mutex, channel);
+}
+
+static void high(void) {
+    uint32_t written = 0U;
+
+    while (1) {
+        bench_read(&channel_down, &reads_high);
+        bench_write(&channel_up, &written);
+        OS_wait_next_period();
+    }
+}
+
+static void low(void) {
+    uint32_t written = 0U;
+
+    bench_cost();
+
+    OS_port_systick_start(BENCH_TICKS_PER_SEC);
+    while (HAL_GetTick() < bench_ticks) {
+        bench_write(&channel_down, &written);
+        bench_read(&channel_up, &reads_low);
+    }
+
+    printf("preempted every tick for %u ticks: %u reads by the high task, "
+           "%u by the low task, %u torn\n", (unsigned)bench_ticks,
+           (unsigned)reads_high, (unsigned)reads_low, (unsigned)torn);
+    exit((torn == 0U) ? 0 : 1);
+}
+
+static void bench_start(bench_task *t, OSThreadHandler handler, uint32_t period) {
+    t->parameters.period_absolute = period;
+    t->parameters.deadline_absolute = period;
+    t->parameters.period_dinamic = period;
+    t->parameters.deadline_dinamic = period;
+    t->TCB_thread.task_parameters = &t->parameters;
+    OSPeriodic_task_start(&t->TCB_thread, handler,
+                          t->stack_thread, sizeof(t->stack_thread));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        bench_ticks = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    mutex_init(&mutex_sample);
+    channel_init(&channel_sample, sizeof(int));
+    channel_init(&channel_down, sizeof(bench_msg));
+    channel_init(&channel_up, sizeof(bench_msg));
+
+    bench_start(&task_high, &high, 1U);
+    bench_start(&task_low, &low, 1000000U);
+    mutex_use(&mutex_sample, &task_low.TCB_thread);
+
+    OS_run();
+}
@@ -0,0 +1,165 @@
+/****************************************************************************
+* Effective resolution of the fan PWM with and without sigma-delta
+* dithering (pwm_dither.c), for several TIM2 prescaler/period pairs.
+*
+* TIM2 runs from the 8 MHz HSI, so a pair gives the PWM frequency and the
+* number of PWM periods the fan sees for each controller output, one per
+* BENCH_SAMPLE_S (the 20 ms timing budget of the sensor). For random
+* duties in the range calc_PID can output (PWM_OFFSET +-0.3), the program
+* replays the pattern as the DMA does, from a random position of the
+* circular buffer, and takes the mean duty over one controller sample.
+*   - plain    : CCR1 = duty * (ARR + 1), truncated, as before
+*   - dithered : pwm_dither_set()
+* The effective bits are -log2 of the largest error of the mean duty, and
+* the codes are the distinct mean duties within the controller range
+* (at most the number of duties drawn).
+* The program also prints the host time of one pwm_dither_set() call.
+*
+*   gcc -O2 -IHost -IInc Src/pwm_dither.c Host/bench_dither.c -lm -o bench_dither
+*
+* usage: bench_dither [duties]
+****************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pwm_dither.h"
+#include "qassert.h"
+
+Q_DEFINE_THIS_FILE
+
+#define BENCH_CLOCK_HZ 8000000.0 /* TIM2 input, HSI */
+#define BENCH_SAMPLE_S 0.02      /* one controller output */
+#define BENCH_DUTY_MIN 0.31      /* PWM_OFFSET - 0.3 */
+#define BENCH_DUTY_MAX 0.91
+
+typedef struct {
+    uint32_t prescaler;
+    uint32_t period; /* ARR + 1 */
+} bench_timer;
+
+static bench_timer const timers[] = {
+    { 8U, 500U },    /* before */
+    { 1U, 4000U },   /* main.c */
+    { 1U, 16000U },
+    { 1U, 1000U },
+    { 1U, 320U },    /* 25 kHz, above hearing */
+};
+
+static uint32_t bench_duties = 100000U;
+static uint32_t bench_state = 2463534242U;
+
+static uint32_t bench_random(void) {
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 17;
+    bench_state ^= bench_state << 5;
+    return bench_state;
+}
+
+static int bench_compare(void const *a, void const *b) {
+    double x = *(double const *)a;
+    double y = *(double const *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* distinct values in a sorted array */
+static uint32_t bench_distinct(double *v, uint32_t n) {
+    uint32_t count = 1U;
+
+    qsort(v, n, sizeof(double), &bench_compare);
+    for (uint32_t i = 1U; i < n; ++i) {
+        if (v[i] - v[i - 1U] > 1e-12) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static void bench_timer_run(bench_timer const *t, double *plain, double *dithered) {
+    static pwm_dither pwm;
+    static uint16_t ccr[PWM_DITHER_PERIODS];
+    double frequency = BENCH_CLOCK_HZ / t->prescaler / t->period;
+    uint32_t periods = (uint32_t)(frequency * BENCH_SAMPLE_S);
+    double error_plain = 0.0;
+    double error_dithered = 0.0;
+
+    pwm_dither_init(&pwm, ccr, 1U, t->period - 1U);
+    for (uint32_t k = 0U; k < bench_duties; ++k) {
+        double duty = BENCH_DUTY_MIN
+                      + (BENCH_DUTY_MAX - BENCH_DUTY_MIN) * (bench_random() / 4294967296.0);
+        q31_t q = Q31(duty);
+        uint32_t start = bench_random() % PWM_DITHER_PERIODS;
+        uint64_t sum = 0U;
+
+        plain[k] = (double)(uint32_t)(((int64_t)q * t->period) >> 31) / t->period;
+
+        pwm_dither_set(&pwm, q);
+        for (uint32_t i = 0U; i < periods; ++i) {
+            sum += ccr[(start + i) % PWM_DITHER_PERIODS];
+        }
+        dithered[k] = (double)sum / periods / t->period;
+
+        if (fabs(plain[k] - duty) > error_plain) {
+            error_plain = fabs(plain[k] - duty);
+        }
+        if (fabs(dithered[k] - duty) > error_dithered) {
+            error_dithered = fabs(dithered[k] - duty);
+        }
+    }
+
+    printf("%3u %6u %8.0f %7u   %5.1f %8u   %5.1f %8u\n",
+           (unsigned)t->prescaler, (unsigned)t->period, frequency, (unsigned)periods,
+           -log2(error_plain), (unsigned)bench_distinct(plain, bench_duties),
+           -log2(error_dithered), (unsigned)bench_distinct(dithered, bench_duties));
+}
+
+static void bench_time(void) {
+    static pwm_dither pwm;
+    static uint16_t ccr[PWM_DITHER_PERIODS];
+    struct timespec t0;
+    struct timespec t1;
+    uint32_t const calls = 1000000U;
+
+    pwm_dither_init(&pwm, ccr, 1U, 4000U - 1U);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0U; i < calls; ++i) {
+        pwm_dither_set(&pwm, (q31_t)(bench_random() >> 1));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("pwm_dither_set: %.1f ns per call (%u periods, host)\n",
+           ((double)(t1.tv_sec - t0.tv_sec) * 1e9 + (double)(t1.tv_nsec - t0.tv_nsec)) / calls,
+           (unsigned)PWM_DITHER_PERIODS);
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+int main(int argc, char *argv[]) {
+    double *plain;
+    double *dithered;
+
+    if (argc > 1) {
+        bench_duties = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+    Q_REQUIRE(bench_duties != 0U);
+    plain = malloc(bench_duties * sizeof(double));
+    dithered = malloc(bench_duties * sizeof(double));
+    Q_ASSERT((plain != (double *)0) && (dithered != (double *)0));
+
+    printf("%u duties in [%.2f, %.2f], mean over one %.0f ms controller sample\n",
+           (unsigned)bench_duties, BENCH_DUTY_MIN, BENCH_DUTY_MAX, BENCH_SAMPLE_S * 1e3);
+    printf("                                   plain            dithered\n");
+    printf("psc counts  PWM(Hz) periods    bits    codes    bits    codes\n");
+    for (unsigned i = 0U; i < sizeof(timers) / sizeof(timers[0]); ++i) {
+        bench_timer_run(&timers[i], plain, dithered);
+    }
+    bench_time();
+
+    free(plain);
+    free(dithered);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/****************************************************************************
+* Deadline misses of a fully utilised task set, Rate Monotonic versus EDF.
+*
+* Two periodic tasks, C=2/T=4 and C=3/T=6 (U = 1.0), are not RM
+* schedulable: the second one misses its deadline in every hyperperiod.
+* Under EDF (-DMIROS_EDF) no job is late. A job "executes" by raising the
+* virtual tick itself, and SysTick_Handler charges each tick to the thread
+* that was running, so preemption by the kernel decides the completion
+* time exactly as on the target. The last tick of a job is raised with
+* interrupts disabled, so it is taken just after the job completed. The kernel deadline counters are printed
+* next to the ones measured here.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_EDF] -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_edf.c -o bench_edf
+*
+* usage: bench_edf [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_deadline.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+    OSThread_periodics_task_parameters parameters;
+    uint32_t cost;     /* C, ticks of execution per job */
+    uint32_t period;   /* T = D */
+    uint32_t executed; /* ticks charged to the current job */
+    uint32_t jobs;
+    uint32_t misses;
+} bench_task;
+
+static bench_task tasks[] = {
+    { .cost = 3U, .period = 6U },
+    { .cost = 2U, .period = 4U },
+};
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static uint32_t bench_ticks = 120000U;
+static uint32_t uwTick;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+
+    /* charge the elapsed tick to the job that ran in it */
+    for (unsigned i = 0U; i < Q_DIM(tasks); ++i) {
+        if (OS_curr == &tasks[i].TCB_thread) {
+            ++tasks[i].executed;
+        }
+    }
+
+    OS_tick();
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+void OS_onIdle(void) {
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static void bench_report(void) {
+    uint32_t jobs = 0U;
+    uint32_t misses = 0U;
+
+    for (unsigned i = 0U; i < Q_DIM(tasks); ++i) {
+        OSThread_deadline_stats const *stats = OS_deadline_stats_get(&tasks[i].TCB_thread);
+
+        printf("task C=%u T=%u : %u jobs, %u deadline misses"
+               " (kernel: %u misses, %u skipped, lateness max %u)\n",
+               (unsigned)tasks[i].cost, (unsigned)tasks[i].period,
+               (unsigned)tasks[i].jobs, (unsigned)tasks[i].misses,
+               (unsigned)stats->misses, (unsigned)stats->skipped,
+               (unsigned)stats->lateness_max);
+        jobs += tasks[i].jobs;
+        misses += tasks[i].misses;
+    }
+#ifdef MIROS_EDF
+    printf("EDF: %u jobs, %u deadline misses\n", (unsigned)jobs, (unsigned)misses);
+#else
+    printf("RM : %u jobs, %u deadline misses\n", (unsigned)jobs, (unsigned)misses);
+#endif
+}
+
+static void bench_job(bench_task *me) {
+    while (1) {
+        /* a late job makes the kernel skip releases, take the last one */
+        uint32_t release = (HAL_GetTick() / me->period) * me->period;
+
+        me->executed = 0U;
+        while (me->executed + 1U < me->cost) {
+            OS_port_tick(); /* run for one tick */
+        }
+
+        /* the job completes within its last tick */
+        __disable_irq();
+        ++me->jobs;
+        if (HAL_GetTick() + 1U > release + me->period) {
+            ++me->misses;
+        }
+        if (HAL_GetTick() >= bench_ticks) {
+            bench_report();
+            exit(0);
+        }
+        OS_port_tick(); /* taken when OS_wait_next_period unmasks */
+        OS_wait_next_period();
+    }
+}
+
+static void job0(void) { bench_job(&tasks[0]); }
+static void job1(void) { bench_job(&tasks[1]); }
+
+int main(int argc, char *argv[]) {
+    static OSThreadHandler const handlers[] = { &job0, &job1 };
+
+    if (argc > 1) {
+        bench_ticks = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    /* lowest RM priority (longest period) first */
+    for (unsigned i = 0U; i < Q_DIM(tasks); ++i) {
+        bench_task *t = &tasks[i];
+        t->parameters.period_absolute = t->period;
+        t->parameters.deadline_absolute = t->period;
+        t->parameters.period_dinamic = t->period;
+        t->parameters.deadline_dinamic = t->period;
+        t->TCB_thread.task_parameters = &t->parameters;
+        OSPeriodic_task_start(&t->TCB_thread, handlers[i],
+                              t->stack_thread, sizeof(t->stack_thread));
+    }
+    OS_run();
+}
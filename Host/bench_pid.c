@@ -0,0 +1,110 @@
+/****************************************************************************
+* Fixed-point PID (pid_fixed.c) against the floating-point PID_action.
+*
+* Both controllers get the same error sequence, a random walk of the
+* distance around the setpoint with occasional setpoint steps, and the
+* program prints the largest difference between their outputs. It exits
+* with status 1 if the difference exceeds BENCH_TOLERANCE. Both have the
+* gains of fan_loop.h.
+*
+* The host has an FPU, so its time per call says nothing of the
+* STM32F103, where the float version goes through the soft-float
+* library. The cost of each version is measured on the target in cycles:
+* calc_PID keeps it in fan_loop.pidCycles in a -DMIROS_TRACE build
+* (README).
+*
+*   gcc -O2 -IHost -IInc Src/pid.c Src/pid_fixed.c Host/bench_pid.c -o bench_pid
+*
+* usage: bench_pid [samples]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "fan_loop.h"
+#include "qassert.h"
+
+#define BENCH_TOLERANCE 1.0e-5 /* of the output, which is clamped to +-0.3 */
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static uint32_t bench_rand(void) {
+    static uint32_t state = 12345U;
+    state = state * 1664525U + 1013904223U;
+    return state >> 8;
+}
+
+int main(int argc, char *argv[]) {
+    static PIDController fpid;
+    static PIDController_fixed qpid;
+    uint32_t samples = 1000000U;
+    int32_t *errors;
+    float *out_float;
+    q31_t *out_fixed;
+    int32_t distance = 200;
+    int32_t setpoint = 200;
+    double diff_max = 0.0;
+    uint32_t diff_at = 0U;
+    uint32_t saturated = 0U;
+
+    if (argc > 1) {
+        samples = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+    errors = malloc(samples * sizeof(*errors));
+    out_float = malloc(samples * sizeof(*out_float));
+    out_fixed = malloc(samples * sizeof(*out_fixed));
+    if ((errors == (int32_t *)0) || (out_float == (float *)0)
+        || (out_fixed == (q31_t *)0)) {
+        return 2;
+    }
+
+    /* distance in mm, setpoint toggled between 200 and 400 like aperiodic_task;
+    * in the second quarter the sensor reads out of range (8190 mm) for a
+    * while, followed by the mirrored error, which winds the integral up
+    * into saturation and back
+    */
+    for (uint32_t i = 0U; i < samples; ++i) {
+        if ((bench_rand() % 500U) == 0U) {
+            setpoint = (setpoint == 400) ? 200 : 400;
+        }
+        distance += (int32_t)(bench_rand() % 21U) - 10;
+        distance += (setpoint - distance) / 16;
+        errors[i] = setpoint - distance;
+        if ((i >= samples / 4U) && (i < samples / 4U + samples / 200U)) {
+            errors[i] = setpoint - 8190;
+        } else if ((i >= samples / 4U) && (i < samples / 4U + samples / 100U)) {
+            errors[i] = 8190 - setpoint;
+        }
+    }
+
+    PID_setup(&fpid, PID_KP, PID_KI, PID_KD, PID_SETPOINT, PID_OUTPUT_MAX, -PID_OUTPUT_MAX);
+    PID_fixed_setup(&qpid, PID_KP, PID_KI, PID_KD, PID_PERIOD,
+                    PID_SETPOINT, PID_OUTPUT_MAX, -PID_OUTPUT_MAX);
+
+    for (uint32_t i = 0U; i < samples; ++i) {
+        out_float[i] = PID_action(&fpid, (float)errors[i]);
+        out_fixed[i] = PID_fixed_action(&qpid, errors[i]);
+    }
+
+    for (uint32_t i = 0U; i < samples; ++i) {
+        double diff = (double)out_float[i] - (double)out_fixed[i] / 2147483648.0;
+        if (diff < 0.0) {
+            diff = -diff;
+        }
+        if (diff > diff_max) {
+            diff_max = diff;
+            diff_at = i;
+        }
+        if ((out_fixed[i] == qpid.max) || (out_fixed[i] == qpid.min)) {
+            ++saturated;
+        }
+    }
+
+    printf("samples          : %u (%u saturated)\n", (unsigned)samples, (unsigned)saturated);
+    printf("max |float-Q31|  : %.3g at sample %u (tolerance %.3g)\n",
+           diff_max, (unsigned)diff_at, BENCH_TOLERANCE);
+
+    return (diff_max <= BENCH_TOLERANCE) ? 0 : 1;
+}
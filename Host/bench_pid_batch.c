@@ -0,0 +1,138 @@
+/****************************************************************************
+* Throughput of the batched PID (pid_batch.c) against one PID_action()
+* call per loop, for N = 1 ... 4096 loops.
+*
+* Every loop gets its own gains, the ones of fan_loop.h scaled by a
+* random factor in [1, 1.2), and its own error sequence, a random walk around the setpoint with occasional steps. The
+* two versions run the same updates of every loop (about the number given
+* on the command line in total, per N) and the program prints the host
+* ns per loop update and the speedup. It exits with status 1 if any
+* output of the batch differs from the scalar one.
+*
+* Plain -O3 vectorises the batch with SSE2, -mavx2 doubles the width:
+*   gcc -O3 [-mavx2] -DPID_BATCH_MAX=4096 -IHost -IInc \
+*       Src/pid.c Src/pid_batch.c Host/bench_pid_batch.c -o bench_pid_batch
+*
+* usage: bench_pid_batch [loop updates per N]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pid.h"
+#include "pid_batch.h"
+#include "qassert.h"
+
+#define BENCH_STEPS 64U    /* error samples per loop, replayed */
+
+static PIDController scalar[PID_BATCH_MAX];
+static PIDBatch batch;
+static float errors[BENCH_STEPS][PID_BATCH_MAX];
+static float out_scalar[BENCH_STEPS][PID_BATCH_MAX];
+static float out_batch[BENCH_STEPS][PID_BATCH_MAX];
+static uint32_t bench_updates = 10000000U;
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t bench_rand(void) {
+    static uint32_t state = 12345U;
+    state = state * 1664525U + 1013904223U;
+    return state >> 8;
+}
+
+static float bench_gain(float gain) {
+    return gain * (1.0f + 0.2f * (float)(bench_rand() % 1000U) / 1000.0f);
+}
+
+static void bench_setup(uint32_t n) {
+    PID_batch_init(&batch, PERIOD_TOF_SENSOR);
+    for (uint32_t i = 0U; i < n; ++i) {
+        int32_t setpoint = 200;
+        int32_t distance = 200;
+
+        PID_setup(&scalar[i], bench_gain(-0.0001f), bench_gain(-0.00001f),
+                  bench_gain(-0.00001f), 200.0f, 0.3f, -0.3f);
+        (void)PID_batch_add(&batch, &scalar[i]);
+
+        for (uint32_t k = 0U; k < BENCH_STEPS; ++k) {
+            if ((bench_rand() % 16U) == 0U) {
+                setpoint = (setpoint == 400) ? 200 : 400;
+            }
+            distance += (int32_t)(bench_rand() % 21U) - 10;
+            distance += (setpoint - distance) / 4;
+            errors[k][i] = (float)(setpoint - distance);
+        }
+    }
+}
+
+/* ns per loop update, and 1 if the outputs differ */
+static int bench_run(uint32_t n, double *ns_scalar, double *ns_batch) {
+    uint32_t rounds = bench_updates / n;
+    uint64_t t0;
+    int differ = 0;
+
+    if (rounds < BENCH_STEPS) {
+        rounds = BENCH_STEPS;
+    }
+
+    t0 = bench_ns();
+    for (uint32_t r = 0U; r < rounds; ++r) {
+        uint32_t k = r % BENCH_STEPS;
+
+        for (uint32_t i = 0U; i < n; ++i) {
+            out_scalar[k][i] = PID_action(&scalar[i], errors[k][i]);
+        }
+    }
+    *ns_scalar = (double)(bench_ns() - t0) / ((double)rounds * n);
+
+    t0 = bench_ns();
+    for (uint32_t r = 0U; r < rounds; ++r) {
+        uint32_t k = r % BENCH_STEPS;
+
+        PID_batch_action(&batch, errors[k], out_batch[k]);
+    }
+    *ns_batch = (double)(bench_ns() - t0) / ((double)rounds * n);
+
+    /* both ran the same updates, so the last outputs and the state agree */
+    for (uint32_t k = 0U; k < BENCH_STEPS; ++k) {
+        for (uint32_t i = 0U; i < n; ++i) {
+            differ |= (out_scalar[k][i] != out_batch[k][i]);
+        }
+    }
+    for (uint32_t i = 0U; i < n; ++i) {
+        differ |= (scalar[i].integral_sum != batch.integral_sum[i]);
+        differ |= (scalar[i].error_prev != batch.error_prev[i]);
+    }
+    return differ;
+}
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+
+    if (argc > 1) {
+        bench_updates = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    printf("    N   scalar ns/loop   batch ns/loop   speedup   outputs\n");
+    for (uint32_t n = 1U; n <= PID_BATCH_MAX; n *= 2U) {
+        double ns_scalar;
+        double ns_batch;
+        int differ;
+
+        bench_setup(n);
+        differ = bench_run(n, &ns_scalar, &ns_batch);
+        failed |= differ;
+        printf("%5u   %14.2f   %13.2f   %6.1fx   %s\n", (unsigned)n, ns_scalar,
+               ns_batch, ns_scalar / ns_batch, differ ? "DIFFER" : "equal");
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+/****************************************************************************
+* Cost of entering and leaving a critical region, before and after the
+* O(1) nesting depth.
+*
+* An uncontended sem_down()/sem_up() pair runs with interrupts disabled
+* from its first to its last statement, so the time of a pair is the time
+* the CPU spends masked for it. One task locks 1, 2, 4 and 8 nested
+* semaphores, [pairs] lock/unlock pairs in total for each depth, and
+* prints the host ns per pair, the fastest of BENCH_RUNS runs, for:
+*   - before : the former sem_down/sem_up, which shifted the whole
+*              critical_regions_historic array on every lock and unlock.
+*              Apart from the history it takes the steps of the current
+*              pair without contention: the check of the token, the scan
+*              of the waiters (none) and OS_sched() in the unlock
+*   - sem    : sem_down/sem_up (NPP slot)
+*   - mutex  : mutex_lock/mutex_unlock (priority ceiling)
+* calc_PID in main.c takes 2 nested mutexes and then 1, every 15 ticks.
+*
+* The host numbers only show how the cost grows with the depth: the
+* masked section of the target runs on another core and another compiler,
+* and it is timed there in cycles with OS_port_cycles() (DWT CYCCNT,
+* -DMIROS_TRACE) around the pair.
+*
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_EDF] -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bsp_posix.c \
+*       Host/bench_region.c -o bench_region
+*
+* usage: bench_region [pairs]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_config.h"
+#include "miros_ceiling.h"
+#include "stm32f1xx_hal.h"
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_MAX_DEPTH 8U
+#define BENCH_RUNS 5U
+
+extern OSThread *OS_tasks[];
+extern uint32_t OS_readySet;
+extern uint32_t OS_semBlockedSet;
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+} bench_task;
+
+static bench_task task_bench;
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+static OSThread_periodics_task_parameters parameters_bench;
+
+static semaphore_t sems[BENCH_MAX_DEPTH];
+static mutex_t mutexes[BENCH_MAX_DEPTH];
+
+static uint32_t bench_pairs = 1000000U;
+static uint32_t run_pairs; /* bench_pairs / BENCH_RUNS */
+
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/* sem_up before the O(1) depth, uncontended: the scan of OS_sem_give()
+* finds no waiter to hand over to and keeps the token
+*/
+static void before_sem_up(semaphore_t *p_semaphore) {
+    __disable_irq();
+
+    if ((OS_semBlockedSet == 0U) && (p_semaphore->sem_value < p_semaphore->max_value))
+        p_semaphore->sem_value++;
+
+    for (uint8_t i = 0; i < NUM_MAX_NESTED_CRITICAL_REGIONS+1; i++){
+        OS_curr->critical_regions_historic[i] = OS_curr->critical_regions_historic[i+1];
+        OS_curr->critical_regions_historic[i+1] = 0;
+
+        if (OS_curr->critical_regions_historic[i] == OS_curr->prio){
+            if (i == 0){
+                uint32_t bit = (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+                OS_readySet &= ~bit;
+                OS_tasks[PRIORITY_CRITICAL_REGION_NPP] = (OSThread *) 0;
+            }
+            break;
+        }
+    }
+
+    OS_sched();
+    __enable_irq();
+}
+
+/* sem_down before the O(1) depth, uncontended: the token is available */
+static void before_sem_down(semaphore_t *p_semaphore) {
+    __disable_irq();
+
+    while (p_semaphore->sem_value == 0){
+        OS_delay(1U);
+        __disable_irq();
+    }
+    p_semaphore->sem_value--;
+
+    for (uint8_t i = 0; i < NUM_MAX_NESTED_CRITICAL_REGIONS+1; i++){
+        if (OS_curr->critical_regions_historic[i] == OS_curr->prio) {
+            for (uint8_t j = i+1; j > 0; j--){
+                OS_curr->critical_regions_historic[j] = OS_curr->critical_regions_historic[j-1];
+            }
+            OS_curr->critical_regions_historic[0] = PRIORITY_CRITICAL_REGION_NPP;
+            OS_tasks[PRIORITY_CRITICAL_REGION_NPP] = OS_curr;
+
+            uint32_t bit = (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+            OS_readySet |= bit;
+            break;
+        }
+    }
+
+    __enable_irq();
+}
+
+/* ns per lock/unlock pair with depth nested regions */
+static double bench_before(unsigned depth) {
+    uint64_t start = bench_ns();
+
+    for (uint32_t n = 0U; n < run_pairs; n += depth) {
+        for (unsigned i = 0U; i < depth; ++i) {
+            before_sem_down(&sems[i]);
+        }
+        for (unsigned i = depth; i > 0U; --i) {
+            before_sem_up(&sems[i - 1U]);
+        }
+    }
+    return (double)(bench_ns() - start) / (double)run_pairs;
+}
+
+static double bench_sem(unsigned depth) {
+    uint64_t start = bench_ns();
+
+    for (uint32_t n = 0U; n < run_pairs; n += depth) {
+        for (unsigned i = 0U; i < depth; ++i) {
+            sem_down(&sems[i]);
+        }
+        for (unsigned i = depth; i > 0U; --i) {
+            sem_up(&sems[i - 1U]);
+        }
+    }
+    return (double)(bench_ns() - start) / (double)run_pairs;
+}
+
+static double bench_mutex(unsigned depth) {
+    uint64_t start = bench_ns();
+
+    for (uint32_t n = 0U; n < run_pairs; n += depth) {
+        for (unsigned i = 0U; i < depth; ++i) {
+            mutex_lock(&mutexes[i]);
+        }
+        for (unsigned i = depth; i > 0U; --i) {
+            mutex_unlock(&mutexes[i - 1U]);
+        }
+    }
+    return (double)(bench_ns() - start) / (double)run_pairs;
+}
+
+static double bench_min(double a, double b) {
+    return (b < a) ? b : a;
+}
+
+static void bench(void) {
+    run_pairs = bench_pairs / BENCH_RUNS;
+
+    printf("nesting   before      sem    mutex   (host ns per lock/unlock pair,"
+           " trend with the depth only)\n");
+    for (unsigned depth = 1U; depth <= BENCH_MAX_DEPTH; depth *= 2U) {
+        double before = bench_before(depth);
+        double sem = bench_sem(depth);
+        double mutex = bench_mutex(depth);
+
+        for (unsigned run = 1U; run < BENCH_RUNS; ++run) {
+            before = bench_min(before, bench_before(depth));
+            sem = bench_min(sem, bench_sem(depth));
+            mutex = bench_min(mutex, bench_mutex(depth));
+        }
+        printf("%7u %8.1f %8.1f %8.1f\n", depth, before, sem, mutex);
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        bench_pairs = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    for (unsigned i = 0U; i < BENCH_MAX_DEPTH; ++i) {
+        semaphore_init(&sems[i], 1, 1);
+        mutex_init(&mutexes[i]);
+    }
+
+    parameters_bench.deadline_absolute = 1000U;
+    parameters_bench.deadline_dinamic = 1000U;
+    parameters_bench.period_absolute = 1000U;
+    parameters_bench.period_dinamic = 1000U;
+    task_bench.TCB_thread.task_parameters = &parameters_bench;
+    OSPeriodic_task_start(&task_bench.TCB_thread, &bench,
+                          task_bench.stack_thread, sizeof(task_bench.stack_thread));
+
+    for (unsigned i = 0U; i < BENCH_MAX_DEPTH; ++i) {
+        mutex_use(&mutexes[i], &task_bench.TCB_thread);
+    }
+    OS_run();
+}
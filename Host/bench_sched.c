@@ -0,0 +1,193 @@
+/****************************************************************************
+* Scheduler overhead benchmark for the POSIX port.
+*
+* Runs the same task structure as main.c (sensor -> PID -> PWM at 5 ticks,
+* NPP mutexes and a button-driven aperiodic job) in virtual time and reports
+* how many kernel ticks per second the host sustains. Built with
+* -DMIROS_TRACE it also prints the execution time, response time and
+* start latency of each periodic task, in host ns.
+*
+* usage: bench_sched [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_trace.h"
+#include "stm32f1xx_hal.h"
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+} bench_task;
+
+static bench_task task_sensor;
+static bench_task task_pid;
+static bench_task task_pwm;
+static bench_task task_button;
+static bench_task task_aperiodic;
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static OSThread_periodics_task_parameters parameters_sensor;
+static OSThread_periodics_task_parameters parameters_pid;
+static OSThread_periodics_task_parameters parameters_pwm;
+static OSThread_periodics_task_parameters parameters_button;
+
+static semaphore_t mutex_current_distance;
+static semaphore_t mutex_pwm_value;
+static semaphore_t mutex_setpoint;
+
+static uint32_t bench_ticks = 1000000U;
+static uint32_t jobs_periodic;
+static uint32_t jobs_aperiodic;
+static int aperiodic_busy;
+static int sample;
+static int setpoint = 200;
+static int pwm;
+static struct timespec t_start;
+
+#ifdef MIROS_TRACE
+static void bench_trace_line(char const *what, OS_trace_stat const *stat) {
+    printf("  %-8s min %8u  mean %10.1f  max %8u  (%u jobs)\n", what,
+           (unsigned)stat->min,
+           stat->count ? (double)stat->sum / (double)stat->count : 0.0,
+           (unsigned)stat->max, (unsigned)stat->count);
+}
+
+static void bench_trace(char const *name, bench_task *task) {
+    OSThread_trace_stats const *stats = OS_trace_stats_get(&task->TCB_thread);
+
+    printf("%s (ns)\n", name);
+    bench_trace_line("exec", &stats->exec);
+    bench_trace_line("response", &stats->response);
+    bench_trace_line("start", &stats->start);
+}
+#endif
+
+static void bench_report(void) {
+    struct timespec t_end;
+    double elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    elapsed = (double)(t_end.tv_sec - t_start.tv_sec)
+              + (double)(t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+
+    printf("ticks            : %u\n", (unsigned)HAL_GetTick());
+    printf("periodic jobs    : %u\n", (unsigned)jobs_periodic);
+    printf("aperiodic jobs   : %u\n", (unsigned)jobs_aperiodic);
+    printf("elapsed          : %.3f s\n", elapsed);
+    printf("ticks per second : %.0f\n", (double)HAL_GetTick() / elapsed);
+    printf("ns per tick      : %.1f\n", elapsed * 1e9 / (double)HAL_GetTick());
+#ifdef MIROS_TRACE
+    bench_trace("sensor", &task_sensor);
+    bench_trace("pid", &task_pid);
+    bench_trace("pwm", &task_pwm);
+    bench_trace("button", &task_button);
+#endif
+}
+
+static void sensor(void) {
+    while (1) {
+        sem_down(&mutex_current_distance);
+        sample = (sample + 7) % 500;
+        sem_up(&mutex_current_distance);
+
+        ++jobs_periodic;
+        OS_wait_next_period();
+    }
+}
+
+static void pid(void) {
+    while (1) {
+        sem_down(&mutex_current_distance);
+        sem_down(&mutex_setpoint);
+        int error = setpoint - sample;
+        sem_up(&mutex_setpoint);
+        sem_up(&mutex_current_distance);
+
+        sem_down(&mutex_pwm_value);
+        pwm = error / 2;
+        sem_up(&mutex_pwm_value);
+
+        ++jobs_periodic;
+        OS_wait_next_period();
+    }
+}
+
+static void pwm_out(void) {
+    while (1) {
+        sem_down(&mutex_pwm_value);
+        (void)pwm;
+        sem_up(&mutex_pwm_value);
+
+        ++jobs_periodic;
+        if (HAL_GetTick() >= bench_ticks) {
+            bench_report();
+            exit(0);
+        }
+        OS_wait_next_period();
+    }
+}
+
+static void aperiodic(void) {
+    sem_down(&mutex_setpoint);
+    setpoint = (setpoint == 400) ? 200 : 400;
+    sem_up(&mutex_setpoint);
+
+    ++jobs_aperiodic;
+    aperiodic_busy = 0;
+    OS_finished_aperiodic_task();
+}
+
+/* stands in for the EXTI button interrupt of the target */
+static void button(void) {
+    while (1) {
+        if (!aperiodic_busy) {
+            aperiodic_busy = 1;
+            OSAperiodic_task_start(&task_aperiodic.TCB_thread,
+                                   &aperiodic,
+                                   task_aperiodic.stack_thread,
+                                   sizeof(task_aperiodic.stack_thread));
+        }
+        OS_wait_next_period();
+    }
+}
+
+static void bench_periodic(bench_task *task,
+    OSThread_periodics_task_parameters *parameters,
+    uint32_t period, OSThreadHandler threadHandler) {
+
+    parameters->deadline_absolute = period;
+    parameters->deadline_dinamic = period;
+    parameters->period_absolute = period;
+    parameters->period_dinamic = period;
+    task->TCB_thread.task_parameters = parameters;
+
+    OSPeriodic_task_start(&task->TCB_thread, threadHandler,
+                          task->stack_thread, sizeof(task->stack_thread));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        bench_ticks = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    semaphore_init(&mutex_setpoint, 1, 1);
+    semaphore_init(&mutex_current_distance, 1, 1);
+    semaphore_init(&mutex_pwm_value, 1, 1);
+
+    /* lowest priority first, OSPeriodic_task_start() appends on top */
+    bench_periodic(&task_button, &parameters_button, 50U, &button);
+    bench_periodic(&task_sensor, &parameters_sensor, 5U, &sensor);
+    bench_periodic(&task_pid, &parameters_pid, 5U, &pid);
+    bench_periodic(&task_pwm, &parameters_pwm, 5U, &pwm_out);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    OS_run();
+}
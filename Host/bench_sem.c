@@ -0,0 +1,202 @@
+/****************************************************************************
+* Semaphore handoff latency benchmark for the POSIX port.
+*
+* A low-priority task takes the mutex and waits inside the critical
+* region for a bus transfer, as the sensor task waits for the I2C DMA. The
+* transfer ends BENCH_HOLD_TICKS later in the middle of a tick: the idle
+* thread plays the DMA interrupt and signals it before it raises the next
+* tick, so the holder gives the mutex back after the other tasks of the
+* tick have run. A high-priority task asks for the mutex one tick after
+* the holder took it. The latency is measured from the sem_up of the
+* holder to the return from sem_down in the waiter, in kernel ticks and in
+* host time, and the run time per handoff shows what the waiter costs
+* while it waits.
+*
+* -DMIROS_SEM_POLL builds the sem_down of the kernel before blocking
+* waits, which looks at the semaphore again every tick: the waiter only
+* sees the mutex free at the next tick. Without it the waiter is blocked
+* and sem_up hands the mutex over at once.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_SEM_POLL] -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_sem.c -o bench_sem
+*
+* usage: bench_sem [handoffs]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_event.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+#ifdef MIROS_TICKLESS
+#error "the transfer ends in OS_onIdle, build without MIROS_TICKLESS"
+#endif
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_HOLD_TICKS 20U
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+} bench_task;
+
+static bench_task task_high;
+static bench_task task_low;
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static OSThread_periodics_task_parameters parameters_high;
+static OSThread_periodics_task_parameters parameters_low;
+
+static semaphore_t mutex;
+static semaphore_t bus_done; /* event of the end of the transfer */
+
+static uint32_t uwTick;
+static int bus_busy;
+static uint32_t bus_start;
+
+static uint32_t bench_handoffs = 1000U;
+static uint32_t handoffs;
+static int released; /* the holder has just called sem_up */
+static uint32_t release_tick;
+static uint64_t release_ns;
+static uint64_t lat_ticks, lat_ticks_max;
+static uint64_t lat_ns, lat_ns_max;
+static uint64_t start_ns;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+    OS_tick();
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+/* every task of the tick has run: the transfer may end before the tick */
+void OS_onIdle(void) {
+    if (bus_busy && ((uwTick - bus_start) >= BENCH_HOLD_TICKS)) {
+        bus_busy = 0;
+        sem_signal(&bus_done);
+    } else {
+        OS_port_tick();
+    }
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_report(void) {
+    printf("handoffs         : %u\n", (unsigned)handoffs);
+    printf("latency (ticks)  : mean %.3f, max %llu\n",
+           (double)lat_ticks / (double)handoffs,
+           (unsigned long long)lat_ticks_max);
+    printf("latency (ns)     : mean %.0f, max %llu\n",
+           (double)lat_ns / (double)handoffs,
+           (unsigned long long)lat_ns_max);
+    printf("run per handoff  : %.0f ns\n",
+           (double)(bench_ns() - start_ns) / (double)handoffs);
+}
+
+/* released together with low, arrives once low holds the mutex */
+static void high(void) {
+    while (1) {
+        OS_delay(1U);
+
+        sem_down(&mutex);
+        if (released) {
+            uint64_t dt_ns = bench_ns() - release_ns;
+            uint32_t dt_ticks = HAL_GetTick() - release_tick;
+
+            released = 0;
+            lat_ns += dt_ns;
+            lat_ticks += dt_ticks;
+            if (dt_ns > lat_ns_max) {
+                lat_ns_max = dt_ns;
+            }
+            if (dt_ticks > lat_ticks_max) {
+                lat_ticks_max = dt_ticks;
+            }
+            ++handoffs;
+        }
+        sem_up(&mutex);
+
+        if (handoffs >= bench_handoffs) {
+            bench_report();
+            exit(0);
+        }
+        OS_wait_next_period();
+    }
+}
+
+static void low(void) {
+    while (1) {
+        sem_down(&mutex);
+        bus_start = uwTick;
+        bus_busy = 1;
+        sem_pend(&bus_done); /* holds the mutex while blocked */
+        released = 1;
+        release_tick = HAL_GetTick();
+        release_ns = bench_ns();
+        sem_up(&mutex);
+
+        OS_wait_next_period();
+    }
+}
+
+static void bench_periodic(bench_task *task,
+    OSThread_periodics_task_parameters *parameters,
+    uint32_t period, OSThreadHandler threadHandler) {
+
+    parameters->deadline_absolute = period;
+    parameters->deadline_dinamic = period;
+    parameters->period_absolute = period;
+    parameters->period_dinamic = period;
+    task->TCB_thread.task_parameters = parameters;
+
+    OSPeriodic_task_start(&task->TCB_thread, threadHandler,
+                          task->stack_thread, sizeof(task->stack_thread));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        bench_handoffs = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    semaphore_init(&mutex, 1, 1);
+    semaphore_init(&bus_done, 0, 1);
+
+    /* lowest priority first, OSPeriodic_task_start() appends on top; one
+    * handoff per period, the hold and the tick after it
+    */
+    bench_periodic(&task_low, &parameters_low, 2U * BENCH_HOLD_TICKS, &low);
+    bench_periodic(&task_high, &parameters_high, 2U * BENCH_HOLD_TICKS, &high);
+
+    start_ns = bench_ns();
+    OS_run();
+}
@@ -0,0 +1,235 @@
+/****************************************************************************
+* Aperiodic response time with a Background, Polling or Deferrable Server.
+*
+* Two periodic tasks, C=3/T=5 and C=2/T=10 (U = 0.8), run with a stream of
+* aperiodic jobs of 1 or 2 ticks arriving at random, on average every
+* BENCH_MEAN_ARRIVAL ticks. With a server (C_s=2, T_s=10, U_s = 0.2) the
+* set is RM schedulable (harmonic periods, U = 1.0). Every job "executes"
+* by raising the virtual tick itself and SysTick_Handler charges each tick
+* to the thread that ran in it, like Host/bench_edf.c. The program prints
+* the mean and worst response time of the aperiodic jobs and the deadline
+* misses of the periodic tasks.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_EDF] -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_server.c -o bench_server
+*
+* usage: bench_server [bs|ps|ds] [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_deadline.h"
+#include "miros_server.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_JOBS 8U            /* aperiodic jobs in flight at most */
+#define BENCH_MEAN_ARRIVAL 20U   /* ticks */
+#define BENCH_SERVER_CAPACITY 2U
+#define BENCH_SERVER_PERIOD 10U
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+    OSThread_periodics_task_parameters parameters;
+    uint32_t cost;     /* ticks of execution per job */
+    uint32_t period;
+    uint32_t executed; /* ticks charged to the current job */
+    uint32_t release;  /* aperiodic: arrival tick */
+    int busy;          /* aperiodic: queued or running */
+} bench_task;
+
+static bench_task periodics[] = {
+    { .cost = 2U, .period = 10U },
+    { .cost = 3U, .period = 5U },
+};
+static bench_task aperiodics[BENCH_JOBS];
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static uint32_t bench_ticks = 200000U;
+static uint32_t uwTick;
+static uint32_t next_arrival = 1U;
+static uint32_t jobs, dropped;
+static uint64_t response_sum;
+static uint32_t response_max;
+static char const *mode = "bs";
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+static uint32_t bench_rand(void) {
+    static uint32_t state = 2463534242U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void bench_report(void) {
+    uint32_t misses = 0U;
+
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        misses += OS_deadline_stats_get(&periodics[i].TCB_thread)->misses;
+    }
+    printf("%s: %u aperiodic jobs, response mean %.2f max %u ticks,"
+           " %u dropped, %u periodic deadline misses\n",
+           mode, (unsigned)jobs, (double)response_sum / (double)jobs,
+           (unsigned)response_max, (unsigned)dropped, (unsigned)misses);
+    exit(0);
+}
+
+static void aperiodic(void);
+
+/* a new aperiodic job every BENCH_MEAN_ARRIVAL ticks on average */
+static void bench_arrival(void) {
+    while (next_arrival <= uwTick) {
+        bench_task *t = (bench_task *)0;
+
+        /* a job that just finished still runs until the switch away */
+        for (unsigned i = 0U; i < BENCH_JOBS; ++i) {
+            if (!aperiodics[i].busy && (OS_curr != &aperiodics[i].TCB_thread)) {
+                t = &aperiodics[i];
+                break;
+            }
+        }
+        if (t == (bench_task *)0) {
+            ++dropped;
+        } else {
+            t->busy = 1;
+            t->cost = 1U + (bench_rand() & 1U);
+            t->executed = 0U;
+            t->release = uwTick;
+            OSAperiodic_task_start(&t->TCB_thread, &aperiodic,
+                                   t->stack_thread, sizeof(t->stack_thread));
+        }
+        next_arrival += 1U + bench_rand() % (2U * BENCH_MEAN_ARRIVAL - 1U);
+    }
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+
+    /* charge the elapsed tick to the job that ran in it */
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        if (OS_curr == &periodics[i].TCB_thread) {
+            ++periodics[i].executed;
+        }
+    }
+    for (unsigned i = 0U; i < BENCH_JOBS; ++i) {
+        if (OS_curr == &aperiodics[i].TCB_thread) {
+            ++aperiodics[i].executed;
+        }
+    }
+
+    OS_tick();
+    bench_arrival();
+
+    if (uwTick >= bench_ticks) {
+        bench_report();
+    }
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+void OS_onIdle(void) {
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+/* run until the job has one tick left, the last one is taken when it ends */
+static void bench_execute(bench_task *me) {
+    while (me->executed + 1U < me->cost) {
+        OS_port_tick(); /* run for one tick */
+    }
+    __disable_irq();
+    OS_port_tick();
+}
+
+static void aperiodic(void) {
+    bench_task *me = (bench_task *)0;
+
+    for (unsigned i = 0U; i < BENCH_JOBS; ++i) {
+        if (OS_curr == &aperiodics[i].TCB_thread) {
+            me = &aperiodics[i];
+        }
+    }
+    Q_ASSERT(me != (bench_task *)0);
+
+    bench_execute(me);
+    {
+        uint32_t response = HAL_GetTick() + 1U - me->release;
+        response_sum += response;
+        if (response > response_max) {
+            response_max = response;
+        }
+        ++jobs;
+        me->busy = 0;
+    }
+    OS_finished_aperiodic_task();
+}
+
+static void bench_job(bench_task *me) {
+    while (1) {
+        me->executed = 0U;
+        bench_execute(me);
+        OS_wait_next_period();
+    }
+}
+
+static void job0(void) { bench_job(&periodics[0]); }
+static void job1(void) { bench_job(&periodics[1]); }
+
+int main(int argc, char *argv[]) {
+    static OSThreadHandler const handlers[] = { &job0, &job1 };
+    OS_server_policy policy = OS_SERVER_BACKGROUND;
+
+    if (argc > 1) {
+        mode = argv[1];
+    }
+    if (strcmp(mode, "ps") == 0) {
+        policy = OS_SERVER_POLLING;
+    } else if (strcmp(mode, "ds") == 0) {
+        policy = OS_SERVER_DEFERRABLE;
+    } else {
+        mode = "bs";
+    }
+    if (argc > 2) {
+        bench_ticks = (uint32_t)strtoul(argv[2], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        bench_task *t = &periodics[i];
+        t->parameters.period_absolute = t->period;
+        t->parameters.deadline_absolute = t->period;
+        t->parameters.period_dinamic = t->period;
+        t->parameters.deadline_dinamic = t->period;
+        t->TCB_thread.task_parameters = &t->parameters;
+        OSPeriodic_task_start(&t->TCB_thread, handlers[i],
+                              t->stack_thread, sizeof(t->stack_thread));
+    }
+    OS_server_start(policy, BENCH_SERVER_CAPACITY, BENCH_SERVER_PERIOD);
+    OS_run();
+}
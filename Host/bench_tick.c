@@ -0,0 +1,165 @@
+/****************************************************************************
+* OS_tick cost versus the number of periodic tasks (POSIX port).
+*
+* For every N in 1..NUM_MAX_PERIODIC_TASKS a child process starts N periodic
+* tasks with periods 5..5+N-1 ticks that only wait for their next period,
+* runs the kernel in virtual time and measures the cycles spent in OS_tick,
+* separately for ticks without and with releases.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX -DNUM_MAX_PERIODIC_TASKS=30 -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bench_tick.c -o bench_tick
+*
+* usage: bench_tick [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_config.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#define BENCH_UNIT "cycles"
+#else
+static inline uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+#define BENCH_CYCLES() bench_ns()
+#define BENCH_UNIT "ns"
+#endif
+
+#define BENCH_STACK_SIZE (16U * 1024U)
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+} bench_task;
+
+extern uint32_t OS_readySet;
+
+static bench_task tasks[NUM_MAX_PERIODIC_TASKS];
+static OSThread_periodics_task_parameters parameters[NUM_MAX_PERIODIC_TASKS];
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static uint32_t bench_ticks = 100000U;
+static unsigned bench_n;
+static uint32_t uwTick;
+static uint64_t idle_cycles, idle_count, idle_max;
+static uint64_t release_cycles, release_count, release_max, released;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+static void bench_report(void) {
+    printf("%4u %14.1f %10llu %14.1f %10llu %12.2f\n", bench_n,
+           idle_count ? (double)idle_cycles / (double)idle_count : 0.0,
+           (unsigned long long)idle_max,
+           release_count ? (double)release_cycles / (double)release_count : 0.0,
+           (unsigned long long)release_max,
+           release_count ? (double)released / (double)release_count : 0.0);
+    fflush(stdout);
+}
+
+void SysTick_Handler(void) {
+    uint32_t before = OS_readySet;
+    uint64_t t0 = BENCH_CYCLES();
+    OS_tick();
+    uint64_t dt = BENCH_CYCLES() - t0;
+    uint32_t newly = OS_readySet & ~before;
+
+    HAL_IncTick();
+    if (newly == 0U) {
+        idle_cycles += dt;
+        ++idle_count;
+        if (dt > idle_max) {
+            idle_max = dt;
+        }
+    } else {
+        release_cycles += dt;
+        ++release_count;
+        released += (uint64_t)__builtin_popcount(newly);
+        if (dt > release_max) {
+            release_max = dt;
+        }
+    }
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+}
+
+void OS_onIdle(void) {
+    if (HAL_GetTick() >= bench_ticks) {
+        bench_report();
+        exit(0);
+    }
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static void waiter(void) {
+    while (1) {
+        OS_wait_next_period();
+    }
+}
+
+static void bench_run(unsigned n) {
+    bench_n = n;
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    /* lowest priority (longest period) first */
+    for (unsigned i = n; i > 0U; --i) {
+        OSThread_periodics_task_parameters *p = &parameters[i - 1U];
+        p->period_absolute = 5U + (i - 1U);
+        p->deadline_absolute = p->period_absolute;
+        p->period_dinamic = p->period_absolute;
+        p->deadline_dinamic = p->deadline_absolute;
+        tasks[i - 1U].TCB_thread.task_parameters = p;
+        OSPeriodic_task_start(&tasks[i - 1U].TCB_thread, &waiter,
+                              tasks[i - 1U].stack_thread,
+                              sizeof(tasks[i - 1U].stack_thread));
+    }
+    OS_run();
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        bench_ticks = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    printf("OS_tick cost in %s over %u ticks\n", BENCH_UNIT, (unsigned)bench_ticks);
+    printf("%4s %14s %10s %14s %10s %12s\n",
+           "N", "no-release", "max", "release", "max", "released");
+    fflush(stdout);
+
+    for (unsigned n = 1U; n <= NUM_MAX_PERIODIC_TASKS; ++n) {
+        pid_t child = fork();
+        if (child == 0) {
+            bench_run(n);
+        }
+        waitpid(child, (int *)0, 0);
+    }
+    return 0;
+}
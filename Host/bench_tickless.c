@@ -0,0 +1,168 @@
+/****************************************************************************
+* Release jitter and tick interrupt count, periodic versus tickless idle.
+*
+* Periodic tasks with co-prime periods check that every job starts exactly
+* on its release tick, and one of them checks that an OS_delay inside the
+* job expires on time. At the end the program prints the worst deviation
+* and how many SysTick interrupts were taken for the elapsed ticks, and
+* exits with status 1 if any release or timeout was late or early.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_TICKLESS] [-DMIROS_POSIX_REALTIME] \
+*       -IHost -IInc Src/miros.c Host/miros_port_posix.c \
+*       Host/bench_tickless.c -o bench_tickless
+*
+* usage: bench_tickless [ticks]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+#define BENCH_STACK_SIZE (64U * 1024U)
+#define BENCH_DELAY_TICKS 3U
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+} bench_task;
+
+typedef struct {
+    bench_task task;
+    OSThread_periodics_task_parameters parameters;
+    uint32_t period;
+    uint32_t jobs;
+} bench_periodic;
+
+static bench_periodic periodics[] = {
+    { .period = 23U }, /* delays BENCH_DELAY_TICKS in every job */
+    { .period = 13U },
+    { .period = 11U },
+    { .period = 7U },  /* highest priority, ends the run */
+};
+static uint64_t stack_idleThread[BENCH_STACK_SIZE / sizeof(uint64_t)];
+
+static uint32_t bench_ticks = 100000U;
+static uint32_t uwTick;
+static uint32_t interrupts;
+static uint32_t jitter_max;
+static uint32_t jitter_count;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+void SysTick_Handler(void) {
+    ++interrupts;
+    HAL_IncTick();
+    OS_tick();
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+#ifdef MIROS_POSIX_REALTIME
+    OS_port_systick_start(TICKS_PER_SEC);
+#endif
+}
+
+/* only called without MIROS_TICKLESS */
+void OS_onIdle(void) {
+#ifdef MIROS_POSIX_REALTIME
+    pause();
+#else
+    OS_port_tick();
+#endif
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static void bench_check(uint32_t expected) {
+    uint32_t now = HAL_GetTick();
+    uint32_t dev = (now > expected) ? (now - expected) : (expected - now);
+
+    if (dev != 0U) {
+        ++jitter_count;
+        if (dev > jitter_max) {
+            jitter_max = dev;
+        }
+    }
+}
+
+static void bench_report(void) {
+    uint32_t jobs = 0U;
+
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        jobs += periodics[i].jobs;
+    }
+#ifdef MIROS_TICKLESS
+    printf("mode             : tickless\n");
+#else
+    printf("mode             : periodic tick\n");
+#endif
+    printf("ticks            : %u\n", (unsigned)HAL_GetTick());
+    printf("tick interrupts  : %u\n", (unsigned)interrupts);
+    printf("jobs             : %u\n", (unsigned)jobs);
+    printf("late/early       : %u (max %u ticks)\n",
+           (unsigned)jitter_count, (unsigned)jitter_max);
+    exit((jitter_count == 0U) ? 0 : 1);
+}
+
+static void bench_job(bench_periodic *me) {
+    while (1) {
+        bench_check(me->jobs * me->period);
+        ++me->jobs;
+        if (me == &periodics[0]) {
+            uint32_t start = HAL_GetTick();
+            OS_delay(BENCH_DELAY_TICKS);
+            bench_check(start + BENCH_DELAY_TICKS);
+        }
+        if ((me == &periodics[Q_DIM(periodics) - 1U])
+            && (HAL_GetTick() >= bench_ticks)) {
+            bench_report();
+        }
+        OS_wait_next_period();
+    }
+}
+
+static void job0(void) { bench_job(&periodics[0]); }
+static void job1(void) { bench_job(&periodics[1]); }
+static void job2(void) { bench_job(&periodics[2]); }
+static void job3(void) { bench_job(&periodics[3]); }
+
+int main(int argc, char *argv[]) {
+    static OSThreadHandler const handlers[] = { &job0, &job1, &job2, &job3 };
+
+    if (argc > 1) {
+        bench_ticks = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    /* lowest priority (longest period) first */
+    for (unsigned i = 0U; i < Q_DIM(periodics); ++i) {
+        bench_periodic *p = &periodics[i];
+        p->parameters.period_absolute = p->period;
+        p->parameters.deadline_absolute = p->period;
+        p->parameters.period_dinamic = p->period;
+        p->parameters.deadline_dinamic = p->period;
+        p->task.TCB_thread.task_parameters = &p->parameters;
+        OSPeriodic_task_start(&p->task.TCB_thread, handlers[i],
+                              p->task.stack_thread,
+                              sizeof(p->task.stack_thread));
+    }
+    OS_run();
+}
@@ -0,0 +1,62 @@
+/****************************************************************************
+* Board support for running MiROS as a Linux process (POSIX port).
+*
+* Plays the role of stm32f1xx_it.c on the target: SysTick ISR, startup and
+* idle callbacks, assertion handler and the HAL tick counter.
+*
+* By default time is virtual: the idle thread raises the next tick at once,
+* so the scheduler runs as fast as the host allows (benchmarks, simulation).
+* Build with -DMIROS_POSIX_REALTIME to tick from SIGALRM at TICKS_PER_SEC.
+*
+* Host build (miros.h and qassert.h are the host versions in Host/):
+*   gcc -O2 -DMIROS_PORT_POSIX -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/bsp_posix.c \
+*       Host/bench_sched.c -o bench_sched
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+static volatile uint32_t uwTick;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+void SysTick_Handler(void) {
+    HAL_IncTick();
+    OS_tick();
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+#ifdef MIROS_POSIX_REALTIME
+    OS_port_systick_start(TICKS_PER_SEC);
+#endif
+}
+
+void OS_onIdle(void) {
+#ifdef MIROS_POSIX_REALTIME
+    pause(); /* stop the process and wait for SIGALRM */
+#else
+    OS_port_tick(); /* nothing to run until the next tick, skip to it */
+#endif
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    fflush(stderr);
+    abort();
+}
@@ -0,0 +1,116 @@
+/****************************************************************************
+* Generator of the gain-scheduling tables of pid_schedule.h.
+*
+* The input has one measurement per line: the distance (mm, as read by
+* the VL53L0X) and the duty that holds the ball there with the integral
+* settled. The hover duty at every breakpoint of pid_schedule.h is
+* interpolated linearly between the measurements and held at the first
+* and last one outside them; it is the bias of the breakpoint, and the
+* scale is the hover duty over the reference, the duty around which the
+* gains of fan_loop.h were tuned (PWM_OFFSET). The program writes
+* Src/pid_schedule_table.c to the standard output:
+*
+*   gcc -O2 -IHost -IInc Host/gen_schedule.c -o gen_schedule
+*   ./gen_schedule Host/schedules/fan_hover.txt 0.61 > Src/pid_schedule_table.c
+*
+* usage: gen_schedule <hover duties> <reference duty>
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pid_schedule.h"
+
+#define GEN_MAX_POINTS 64U
+
+static double distance[GEN_MAX_POINTS];
+static double hover[GEN_MAX_POINTS];
+static unsigned count;
+
+static void gen_fail(char const *what, char const *detail) {
+    fprintf(stderr, "gen_schedule: %s: %s\n", what, detail);
+    exit(2);
+}
+
+static void gen_load(char const *path) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+
+    if (f == (FILE *)0) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), f) != (char *)0) {
+        double d, h;
+
+        if ((line[0] == '#') || (sscanf(line, "%lf %lf", &d, &h) != 2)) {
+            continue;
+        }
+        if (count == GEN_MAX_POINTS) {
+            gen_fail("too many measurements", path);
+        }
+        if ((count > 0U) && (d <= distance[count - 1U])) {
+            gen_fail("distances must increase", line);
+        }
+        if ((h <= 0.0) || (h >= 1.0)) {
+            gen_fail("hover duty out of (0, 1)", line);
+        }
+        distance[count] = d;
+        hover[count] = h;
+        ++count;
+    }
+    fclose(f);
+    if (count == 0U) {
+        gen_fail("no measurements in", path);
+    }
+}
+
+static double gen_hover(double d) {
+    unsigned i = 1U;
+
+    if (d <= distance[0]) {
+        return hover[0];
+    }
+    if (d >= distance[count - 1U]) {
+        return hover[count - 1U];
+    }
+    while (distance[i] < d) {
+        ++i;
+    }
+    return hover[i - 1U] + (hover[i] - hover[i - 1U]) * (d - distance[i - 1U])
+                           / (distance[i] - distance[i - 1U]);
+}
+
+/* hover(d) / divisor at every breakpoint, times 'one' */
+static void gen_table(char const *name, double divisor, double one) {
+    printf("q31_t const %s[PID_SCHEDULE_POINTS] = {\n", name);
+    for (unsigned i = 0U; i < PID_SCHEDULE_POINTS; ++i) {
+        double d = (double)(i << PID_SCHEDULE_STEP_BITS);
+        double value = gen_hover(d) / divisor;
+
+        printf("    %10ld, /* %3.0f mm: %.4f */\n", (long)(value * one + 0.5), d, value);
+    }
+    printf("};\n");
+}
+
+int main(int argc, char *argv[]) {
+    double reference;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <hover duties> <reference duty>\n", argv[0]);
+        return 2;
+    }
+    reference = strtod(argv[2], (char **)0);
+    if ((reference <= 0.0) || (reference >= 1.0)) {
+        gen_fail("reference duty out of (0, 1)", argv[2]);
+    }
+    gen_load(argv[1]);
+
+    printf("/* Generated by Host/gen_schedule.c from %s, reference %s,\n"
+           "* do not edit */\n", argv[1], argv[2]);
+    printf("#include <stdint.h>\n#include \"pid_schedule.h\"\n\n");
+    printf("/* hover duty */\n");
+    gen_table("pid_schedule_bias", 1.0, 2147483648.0);
+    printf("\n/* hover duty / reference */\n");
+    gen_table("pid_schedule_scale", reference, (double)PID_SCHEDULE_ONE);
+    return 0;
+}
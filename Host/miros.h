@@ -0,0 +1,85 @@
+/****************************************************************************
+* Host stand-in for the miros.h of the board.
+*
+* The board project keeps miros.h (and qassert.h) in its own include
+* directory, outside this tree. This copy declares the same types and
+* services, so that Src/miros.c and the programs in Host/ build on a
+* POSIX host with -IHost -IInc. The layout of OSThread and struct_tasks
+* is the one of the board (the offsets used by the PendSV of the Cortex-M3
+* port); TICKS_PER_SEC is the 1 ms tick of the board.
+****************************************************************************/
+#ifndef MIROS_H
+#define MIROS_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+#define TICKS_PER_SEC 1000U
+
+typedef struct {
+    uint32_t deadline_absolute;
+    uint32_t deadline_dinamic;
+    uint32_t period_absolute;
+    uint32_t period_dinamic;
+} OSThread_periodics_task_parameters;
+
+/* Thread Control Block (TCB) */
+typedef struct {
+    void *sp; /* stack pointer */
+    uint32_t timeout; /* timeout delay down-counter */
+    uint8_t prio; /* thread priority */
+    OSThread_periodics_task_parameters *task_parameters;
+    uint8_t critical_regions_historic[11];
+} OSThread;
+
+typedef struct {
+    uint32_t sem_value;
+    uint32_t max_value;
+} semaphore_t;
+
+typedef struct {
+    OSThread TCB_thread;
+    uint32_t stack_thread[40];
+} struct_tasks;
+
+typedef void (*OSThreadHandler)();
+
+void OS_init(void *stkSto, uint32_t stkSize);
+
+/* callback to handle the idle condition */
+void OS_onIdle(void);
+
+/* this function must be called with interrupts DISABLED */
+void OS_sched(void);
+
+/* transfer control to the RTOS to run the threads */
+void OS_run(void);
+
+/* blocking delay */
+void OS_delay(uint32_t ticks);
+
+/* process all timeouts */
+void OS_tick(void);
+
+/* callback to configure and start interrupts */
+void OS_onStartup(void);
+
+void OS_error();
+void OS_wait_next_period();
+void OS_finished_aperiodic_task(void);
+
+void semaphore_init(semaphore_t *p_semaphore, uint32_t start_value, uint32_t max_value);
+void sem_up(semaphore_t *p_semaphore);
+void sem_down(semaphore_t *p_semaphore);
+
+void OSAperiodic_task_start(
+    OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize);
+
+void OSPeriodic_task_start(
+    OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize);
+
+#endif /* MIROS_H */
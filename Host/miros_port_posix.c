@@ -0,0 +1,229 @@
+/****************************************************************************
+* MiROS port to POSIX (Linux user space).
+*
+* Each thread gets a ucontext_t carved from the top of its own stack
+* storage, so OSThread.sp simply points to that context. PRIMASK is a flag:
+* the SysTick "interrupt" (SIGALRM or OS_port_tick()) arriving while it is
+* set is latched and replayed by OS_port_enable_irq(), and the PendSV
+* request is serviced only when no interrupt is active, exactly like the
+* Cortex-M3 tail-chaining.
+****************************************************************************/
+#define _XOPEN_SOURCE 700
+#include <stdint.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+/* smallest usable stack left below the context frame */
+#define OS_PORT_MIN_STACK 8192U
+
+/* longest tickless sleep, in ticks */
+#define OS_PORT_MAX_SLEEP 0xFFFFU
+
+typedef struct {
+    ucontext_t ctx;
+    OSThreadHandler threadHandler;
+} OS_port_frame;
+
+static volatile sig_atomic_t OS_port_primask = 0; /* 1 = interrupts disabled */
+static volatile sig_atomic_t OS_port_isrActive = 0; /* inside SysTick_Handler */
+static volatile sig_atomic_t OS_port_pendSV = 0; /* context switch requested */
+static volatile sig_atomic_t OS_port_ticksRaised = 0; /* written by OS_port_tick() only */
+static volatile sig_atomic_t OS_port_ticksServed = 0; /* written by OS_port_service() only */
+static uint32_t OS_port_tickUsec = 0U; /* SIGALRM period, 0 in virtual time */
+
+static ucontext_t OS_port_mainCtx; /* context of main(), left by OS_run() */
+
+static void OS_port_service(void);
+
+void OS_port_init(void) {
+    OS_port_primask = 0;
+    OS_port_isrActive = 0;
+    OS_port_pendSV = 0;
+    OS_port_ticksRaised = 0;
+    OS_port_ticksServed = 0;
+}
+
+static void OS_port_thread_entry(void) {
+    OS_port_frame *frame = (OS_port_frame *)OS_curr->sp;
+
+    /* a new thread starts like the exception return on the target */
+    OS_port_enable_irq();
+    (*frame->threadHandler)();
+
+    /* threads must never return */
+    Q_ERROR();
+}
+
+void OS_port_thread_init(OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize) {
+
+    /* round down the frame to the 16-byte boundary at the stack top */
+    uintptr_t top = ((uintptr_t)stkSto + stkSize - sizeof(OS_port_frame))
+                    & ~(uintptr_t)0xFU;
+    OS_port_frame *frame = (OS_port_frame *)top;
+
+    Q_REQUIRE(top >= (uintptr_t)stkSto + OS_PORT_MIN_STACK);
+
+    getcontext(&frame->ctx);
+    frame->ctx.uc_stack.ss_sp = stkSto;
+    frame->ctx.uc_stack.ss_size = top - (uintptr_t)stkSto;
+    frame->ctx.uc_link = (ucontext_t *)0;
+    sigemptyset(&frame->ctx.uc_sigmask);
+    frame->threadHandler = threadHandler;
+    makecontext(&frame->ctx, &OS_port_thread_entry, 0);
+
+    me->sp = frame;
+}
+
+void OS_port_context_switch(void) {
+    OS_port_pendSV = 1;
+}
+
+/* the PendSV "exception", always entered with interrupts disabled */
+static void OS_port_pendsv(void) {
+    OSThread *prev = OS_curr;
+    OSThread *next = OS_next;
+
+    OS_port_pendSV = 0;
+    if (next == prev) {
+        return;
+    }
+
+#ifdef MIROS_TRACE
+    OS_trace_switch();
+#endif
+    OS_curr = next;
+    if (prev == (OSThread *)0) {
+        swapcontext(&OS_port_mainCtx, &((OS_port_frame *)next->sp)->ctx);
+    } else {
+        swapcontext(&((OS_port_frame *)prev->sp)->ctx,
+                    &((OS_port_frame *)next->sp)->ctx);
+    }
+    /* resumed: the thread that switched to us left PRIMASK set */
+}
+
+/* run latched ticks and the pending context switch, PRIMASK clear on exit */
+static void OS_port_service(void) {
+    for (;;) {
+        OS_port_primask = 1;
+        if (OS_port_ticksServed != OS_port_ticksRaised) {
+            ++OS_port_ticksServed;
+            OS_port_primask = 0;
+            OS_port_isrActive = 1;
+            SysTick_Handler();
+            OS_port_isrActive = 0;
+        } else if (OS_port_pendSV) {
+            OS_port_pendsv();
+        } else {
+            break;
+        }
+    }
+    OS_port_primask = 0;
+}
+
+void OS_port_disable_irq(void) {
+    OS_port_primask = 1;
+    __asm volatile ("" ::: "memory");
+}
+
+void OS_port_enable_irq(void) {
+    __asm volatile ("" ::: "memory");
+    OS_port_primask = 0;
+
+    /* PendSV has the lowest priority, nothing happens until ISR exit */
+    if (!OS_port_isrActive) {
+        OS_port_service();
+    }
+}
+
+void OS_port_tick(void) {
+    ++OS_port_ticksRaised;
+
+    /* latched while masked, replayed by OS_port_enable_irq() */
+    if (!OS_port_primask && !OS_port_isrActive) {
+        OS_port_service();
+    }
+}
+
+static void OS_port_sigalrm(int sig) {
+    (void)sig;
+    OS_port_tick();
+}
+
+void OS_port_systick_start(uint32_t ticks_per_sec) {
+    struct sigaction sa;
+    struct itimerval period;
+
+    Q_REQUIRE((ticks_per_sec > 0U) && (ticks_per_sec <= 1000000U));
+
+    sa.sa_handler = &OS_port_sigalrm;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, (struct sigaction *)0);
+
+    OS_port_tickUsec = 1000000U / ticks_per_sec;
+    period.it_interval.tv_sec = 0;
+    period.it_interval.tv_usec = OS_port_tickUsec;
+    period.it_value = period.it_interval;
+    setitimer(ITIMER_REAL, &period, (struct itimerval *)0);
+}
+
+#ifdef MIROS_TRACE
+uint32_t OS_port_cycles(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+#ifdef MIROS_TICKLESS
+uint32_t OS_port_sleep(uint32_t ticks) {
+    uint32_t skipped;
+
+    if (ticks > OS_PORT_MAX_SLEEP) {
+        ticks = OS_PORT_MAX_SLEEP;
+    }
+    skipped = (ticks > 1U) ? (ticks - 1U) : 0U;
+
+    if (OS_port_tickUsec == 0U) {
+        /* virtual time: nothing happens before the event, jump to it */
+        OS_port_tick(); /* latched until PRIMASK is cleared */
+    } else {
+        /* real time: one SIGALRM at the event, periodic again after it */
+        uint64_t usec = (uint64_t)ticks * OS_port_tickUsec;
+        sig_atomic_t raised = OS_port_ticksRaised;
+        struct itimerval timer;
+        sigset_t alrm, old;
+
+        sigemptyset(&alrm);
+        sigaddset(&alrm, SIGALRM);
+        sigprocmask(SIG_BLOCK, &alrm, &old);
+
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = OS_port_tickUsec;
+        timer.it_value.tv_sec = (time_t)(usec / 1000000U);
+        timer.it_value.tv_usec = (suseconds_t)(usec % 1000000U);
+        setitimer(ITIMER_REAL, &timer, (struct itimerval *)0);
+
+        while (OS_port_ticksRaised == raised) {
+            sigsuspend(&old);
+        }
+        sigprocmask(SIG_SETMASK, &old, (sigset_t *)0);
+    }
+
+    for (uint32_t i = 0U; i < skipped; i++) {
+        HAL_IncTick();
+    }
+    return skipped;
+}
+#endif /* MIROS_TICKLESS */
@@ -0,0 +1,26 @@
+/****************************************************************************
+* Host stand-in for the qassert.h of the board (see miros.h).
+*
+* Same macros as the board; Q_onAssert() is provided by each host program
+* (bsp_posix.c or the program itself), where the board resets.
+****************************************************************************/
+#ifndef QASSERT_H
+#define QASSERT_H
+
+#define Q_DEFINE_THIS_FILE \
+    static char const Q_this_module_[] = __FILE__;
+
+#define Q_ASSERT(test_) ((test_) \
+    ? (void)0 : Q_onAssert(&Q_this_module_[0], (int)__LINE__))
+
+#define Q_ERROR() \
+    Q_onAssert(&Q_this_module_[0], (int)__LINE__)
+
+#define Q_REQUIRE(test_) Q_ASSERT(test_)
+#define Q_ENSURE(test_)  Q_ASSERT(test_)
+
+#define Q_DIM(array_) (sizeof(array_) / sizeof((array_)[0U]))
+
+void Q_onAssert(char const *module, int location);
+
+#endif /* QASSERT_H */
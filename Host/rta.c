@@ -0,0 +1,731 @@
+/****************************************************************************
+* Offline schedulability analysis of a MiROS task set.
+*
+*   - fixed priority: exact response-time analysis, R_i the smallest
+*     solution of R = C_i + B_i + sum_{j in hp(i)} ceil(R / T_j) C_j
+*   - EDF: processor demand, sum_i max(0, floor((t - D_i) / T_i) + 1) C_i
+*     + B(t) <= t at every absolute deadline t up to the bound of the
+*     busy period
+* The priorities are the ones OS_task_insert gives: shorter D first, then
+* shorter T, then the task started last. The blocking terms follow the
+* kernel protocols:
+*   - mutex_t (default): a task is blocked at most once, by the longest
+*     critical section of a lower task on a mutex whose ceiling is at or
+*     above its priority (IPCP under RM, SRP under EDF)
+*   - sem_down ("npp"): by the longest critical section of any lower task
+* The aperiodic jobs of the server hold their mutexes in the NPP slot,
+* so their sections also block the tasks above the server.
+* For every task the tool also reports how much its C can grow with the
+* whole set still schedulable (binary search on the same test).
+*
+* The task set file has one task per line, in ticks, the format of
+* Host/sim_sched.c with critical sections appended:
+*
+*   name  C  [T  D]  [mutex:length ...]
+*
+* With main.c, the tool takes T, D, the start order, the mutex_use()
+* declarations and the OS_server_start() capacity and period from the
+* source, and the file only gives the costs (C may be fractional) and the
+* critical section lengths. The server is the task named "server". A
+* mutex declared with mutex_use() and without a length in the file is
+* taken as held for the whole C of the task. A task whose struct_ variable
+* is indexed (struct_calc_pid[i], one per control loop) stands for
+* LOOP_COUNT tasks started one after the other, named calc_PID[0] ...,
+* with the same C, T, D and mutexes. The #defines are read from main.c
+* and from the headers it includes with quotes, next to it or in ../Inc
+* (fan_loop.h); NAME=value on the command line overrides one, as
+* -DNAME=value does for the build.
+*
+*   gcc -O2 -IHost Host/rta.c -lm -o rta
+*
+* usage: rta <task set> [main.c] [npp] [NAME=value ...]
+****************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTA_MAX_TASKS 11U     /* NUM_MAX_PERIODIC_TASKS plus the server */
+#define RTA_MAX_MUTEXES 8U
+#define RTA_MAX_DEFINES 64U
+#define RTA_MAX_POINTS 10000000U
+#define RTA_EPSILON 1e-9
+
+typedef struct {
+    char name[64];
+    char params[64];  /* main.c: parameters_... variable */
+    char thread[64];  /* main.c: struct_... variable */
+    double cost;      /* C */
+    uint32_t period;  /* T */
+    uint32_t deadline;/* D */
+    int has_cost;
+    int order;        /* start order, -1 if not started */
+    unsigned loops;   /* one task per control loop, 0 if not indexed */
+    int server;       /* runs aperiodic jobs, sections in the NPP slot */
+    double section[RTA_MAX_MUTEXES]; /* length of the critical section, 0 if unused */
+    unsigned prio;    /* 1 is the lowest */
+} rta_task;
+
+typedef struct {
+    char name[64];
+    long value;
+} rta_define;
+
+static rta_task tasks[RTA_MAX_TASKS];
+static unsigned task_count;
+static char mutexes[RTA_MAX_MUTEXES][32];
+static unsigned mutex_count;
+static rta_define defines[RTA_MAX_DEFINES];
+static unsigned define_count;
+static int npp;
+
+static void rta_fail(char const *what, char const *detail) {
+    fprintf(stderr, "rta: %s: %s\n", what, detail);
+    exit(2);
+}
+
+static rta_task *rta_find(char const *name, int add) {
+    for (unsigned i = 0U; i < task_count; ++i) {
+        if (strcmp(tasks[i].name, name) == 0) {
+            return &tasks[i];
+        }
+    }
+    if (!add) {
+        return (rta_task *)0;
+    }
+    if (task_count == RTA_MAX_TASKS) {
+        rta_fail("too many tasks", name);
+    }
+    snprintf(tasks[task_count].name, sizeof(tasks[0].name), "%s", name);
+    tasks[task_count].order = -1;
+    return &tasks[task_count++];
+}
+
+static unsigned rta_mutex(char const *name) {
+    for (unsigned i = 0U; i < mutex_count; ++i) {
+        if (strcmp(mutexes[i], name) == 0) {
+            return i;
+        }
+    }
+    if (mutex_count == RTA_MAX_MUTEXES) {
+        rta_fail("too many mutexes", name);
+    }
+    snprintf(mutexes[mutex_count], sizeof(mutexes[0]), "%s", name);
+    return mutex_count++;
+}
+
+/* a number or a #define of main.c */
+static long rta_value(char const *token) {
+    char *end;
+    long v = strtol(token, &end, 0);
+
+    if (end != token) {
+        return v;
+    }
+    for (unsigned i = 0U; i < define_count; ++i) {
+        if (strcmp(defines[i].name, token) == 0) {
+            return defines[i].value;
+        }
+    }
+    rta_fail("main.c: unknown value", token);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* main.c */
+
+static rta_task *rta_task_of_thread(char const *thread) {
+    for (unsigned i = 0U; i < task_count; ++i) {
+        if (strcmp(tasks[i].thread, thread) == 0) {
+            return &tasks[i];
+        }
+    }
+    return (rta_task *)0;
+}
+
+/* one statement of main.c, whitespace removed */
+static void rta_statement(char const *statement) {
+    static int started;
+    char s[1024];
+    char a[64], b[64], c[64];
+    size_t len = 0U;
+    int indexed = 0;
+    rta_task *t;
+
+    /* struct_X[i] is struct_X, for every loop */
+    for (char const *p = statement; *p != '\0'; ++p) {
+        if ((*p == '[') && (strchr(p, ']') != (char *)0)) {
+            p = strchr(p, ']');
+            indexed = 1;
+        } else if (len + 1U < sizeof(s)) {
+            s[len++] = *p;
+        }
+    }
+    s[len] = '\0';
+
+    if (sscanf(s, "struct_%63[A-Za-z0-9_].TCB_thread.task_parameters=&parameters_%63[A-Za-z0-9_]", a, b) == 2) {
+        /* named by the thread handler once started, parameters until then */
+        for (unsigned i = 0U; i < task_count; ++i) {
+            if (strcmp(tasks[i].params, b) == 0) {
+                snprintf(tasks[i].thread, sizeof(tasks[i].thread), "%s", a);
+                tasks[i].loops = indexed ? (unsigned)rta_value("LOOP_COUNT") : 0U;
+            }
+        }
+    } else if (sscanf(s, "parameters_%63[A-Za-z0-9_].%63[a-z_]=%63[A-Za-z0-9_]", a, b, c) == 3) {
+        t = (rta_task *)0;
+        for (unsigned i = 0U; i < task_count; ++i) {
+            if (strcmp(tasks[i].params, a) == 0) {
+                t = &tasks[i];
+            }
+        }
+        if (t == (rta_task *)0) {
+            t = rta_find(a, 1);
+            snprintf(t->params, sizeof(t->params), "%s", a);
+        }
+        if (strcmp(b, "period_absolute") == 0) {
+            t->period = (uint32_t)rta_value(c);
+        } else if (strcmp(b, "deadline_absolute") == 0) {
+            t->deadline = (uint32_t)rta_value(c);
+        }
+    } else if ((sscanf(s, "OSPeriodic_task_start(&struct_%63[A-Za-z0-9_].TCB_thread,&%63[A-Za-z0-9_]", a, b) == 2)
+               || (sscanf(s, "OSSporadic_task_start(&struct_%63[A-Za-z0-9_].TCB_thread,&%63[A-Za-z0-9_]", a, b) == 2)) {
+        t = rta_task_of_thread(a);
+        if (t == (rta_task *)0) {
+            rta_fail("main.c: task started without parameters", a);
+        }
+        snprintf(t->name, sizeof(t->name), "%s", b);
+        t->order = started;
+        started += (t->loops != 0U) ? (int)t->loops : 1;
+    } else if (sscanf(s, "mutex_use(&%63[A-Za-z0-9_],&struct_%63[A-Za-z0-9_].TCB_thread", a, b) == 2) {
+        t = rta_task_of_thread(b);
+        if (t == (rta_task *)0) {
+            rta_fail("main.c: mutex_use of an unknown task", b);
+        }
+        t->section[rta_mutex(a)] = -1.0; /* length from the file, or C */
+    } else if (sscanf(s, "OS_server_start(%63[A-Za-z0-9_],%63[A-Za-z0-9_],%63[A-Za-z0-9_])", a, b, c) == 3) {
+        t = rta_find("server", 1);
+        t->cost = (double)rta_value(b);
+        t->has_cost = 1;
+        t->period = (uint32_t)rta_value(c);
+        t->deadline = t->period;
+        t->server = 1;
+        t->order = started++;
+    }
+}
+
+/* a #define with a number, returns 0 if the line is not a #define */
+static int rta_define_line(char const *line) {
+    char name[64], value[64];
+
+    if (sscanf(line, " #define %63s %63s", name, value) == 2) {
+        char *end;
+        long v = strtol(value, &end, 0);
+
+        if ((end != value) && (define_count < RTA_MAX_DEFINES)) {
+            snprintf(defines[define_count].name, sizeof(defines[0].name), "%s", name);
+            defines[define_count++].value = v;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* the #defines of a header of main.c, if it is in the tree */
+static void rta_load_header(char const *main_c, char const *header) {
+    static char const *const dirs[] = { "", "../Inc/" };
+    char const *slash = strrchr(main_c, '/');
+    int dir_len = (slash != (char *)0) ? (int)(slash - main_c + 1) : 0;
+    char path[512];
+    char line[512];
+
+    for (unsigned i = 0U; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+        FILE *f;
+
+        snprintf(path, sizeof(path), "%.*s%s%s", dir_len, main_c, dirs[i], header);
+        f = fopen(path, "r");
+        if (f != (FILE *)0) {
+            while (fgets(line, sizeof(line), f) != (char *)0) {
+                (void)rta_define_line(line);
+            }
+            fclose(f);
+            return;
+        }
+    }
+}
+
+static void rta_load_main(char const *path) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    char statement[1024];
+    size_t len = 0U;
+    int comment = 0;
+
+    if (f == (FILE *)0) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), f) != (char *)0) {
+        char header[128];
+
+        if (rta_define_line(line)) {
+            continue;
+        }
+        if (sscanf(line, " #include \"%127[^\"]\"", header) == 1) {
+            rta_load_header(path, header);
+            continue;
+        }
+        if (line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+        /* statements without whitespace and comments, split at ';' */
+        for (char const *p = line; *p != '\0'; ++p) {
+            if (comment) {
+                if ((p[0] == '*') && (p[1] == '/')) {
+                    comment = 0;
+                    ++p;
+                }
+            } else if ((p[0] == '/') && (p[1] == '*')) {
+                comment = 1;
+                ++p;
+            } else if ((p[0] == '/') && (p[1] == '/')) {
+                break;
+            } else if ((*p == ';') || (*p == '{') || (*p == '}')) {
+                statement[len] = '\0';
+                rta_statement(statement);
+                len = 0U;
+            } else if ((*p != ' ') && (*p != '\t') && (*p != '\n') && (*p != '\r')
+                       && (len + 1U < sizeof(statement))) {
+                statement[len++] = *p;
+            }
+        }
+    }
+    fclose(f);
+
+    /* parameters never started are not tasks */
+    for (unsigned i = 0U; i < task_count; ) {
+        if (tasks[i].order < 0) {
+            tasks[i] = tasks[--task_count];
+        } else {
+            ++i;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+/* task set file */
+
+static void rta_load_tasks(char const *path, int with_main) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int order = 1000; /* started after the tasks of main.c */
+
+    if (f == (FILE *)0) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), f) != (char *)0) {
+        char *token = strtok(line, " \t\r\n");
+        unsigned numbers = 0U;
+        double value[3];
+        rta_task *t;
+
+        if ((token == (char *)0) || (token[0] == '#')) {
+            continue;
+        }
+        t = rta_find(token, 0);
+        if (t == (rta_task *)0) {
+            t = rta_find(token, 1);
+            t->order = order++;
+        } else if (!with_main) {
+            rta_fail("task listed twice", token);
+        }
+        while ((token = strtok((char *)0, " \t\r\n")) != (char *)0) {
+            char *colon = strchr(token, ':');
+
+            if (colon != (char *)0) {
+                *colon = '\0';
+                t->section[rta_mutex(token)] = strtod(colon + 1, (char **)0);
+            } else if (numbers < 3U) {
+                value[numbers++] = strtod(token, (char **)0);
+            }
+        }
+        if (numbers == 0U) {
+            rta_fail("no C for", t->name);
+        }
+        /* main.c gives the server capacity, T and D */
+        if (!t->server) {
+            t->cost = value[0];
+            t->has_cost = 1;
+        }
+        if ((t->period == 0U) && (numbers >= 3U)) {
+            t->period = (uint32_t)value[1];
+            t->deadline = (uint32_t)value[2];
+        }
+    }
+    fclose(f);
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        rta_task *t = &tasks[i];
+
+        if (!t->has_cost) {
+            rta_fail("no C in the task set for", t->name);
+        }
+        if ((t->period == 0U) || (t->deadline == 0U) || (t->deadline > t->period)) {
+            rta_fail("need 0 < D <= T for", t->name);
+        }
+        for (unsigned m = 0U; m < mutex_count; ++m) {
+            if (t->section[m] < 0.0) {
+                t->section[m] = t->cost; /* declared, length unknown */
+            }
+        }
+    }
+}
+
+/* one copy per control loop of the indexed tasks, in start order */
+static void rta_expand_loops(void) {
+    for (unsigned i = 0U, n = task_count; i < n; ++i) {
+        rta_task base = tasks[i];
+
+        for (unsigned k = 0U; k < base.loops; ++k) {
+            rta_task *t = (k == 0U) ? &tasks[i] : rta_find("", 1);
+
+            *t = base;
+            snprintf(t->name, sizeof(t->name), "%.50s[%u]", base.name, k);
+            t->order = base.order + (int)k;
+        }
+    }
+}
+
+/* OS_task_insert order: shorter D, then shorter T, then started last */
+static int rta_higher(rta_task const *a, rta_task const *b) {
+    if (a->deadline != b->deadline) {
+        return a->deadline < b->deadline;
+    }
+    if (a->period != b->period) {
+        return a->period < b->period;
+    }
+    return a->order > b->order;
+}
+
+static int rta_compare(void const *x, void const *y) {
+    rta_task const *a = (rta_task const *)x;
+    rta_task const *b = (rta_task const *)y;
+
+    return rta_higher(a, b) ? -1 : (rta_higher(b, a) ? 1 : 0);
+}
+
+/* ---------------------------------------------------------------------- */
+/* analysis, tasks[] sorted from the highest priority */
+
+static unsigned rta_ceiling(unsigned m) {
+    unsigned ceiling = 0U;
+
+    for (unsigned j = 0U; j < task_count; ++j) {
+        if ((tasks[j].section[m] > 0.0) && !tasks[j].server && (tasks[j].prio > ceiling)) {
+            ceiling = tasks[j].prio;
+        }
+    }
+    return ceiling;
+}
+
+/* longest section of a lower task that can block task i */
+static double rta_blocking(unsigned i) {
+    double b = 0.0;
+
+    for (unsigned j = 0U; j < task_count; ++j) {
+        if (tasks[j].prio >= tasks[i].prio) {
+            continue;
+        }
+        for (unsigned m = 0U; m < mutex_count; ++m) {
+            double s = tasks[j].section[m];
+
+            if ((s > b) && (npp || tasks[j].server || (rta_ceiling(m) >= tasks[i].prio))) {
+                b = s;
+            }
+        }
+    }
+    return b;
+}
+
+/* worst response time of task i, or a value above D_i */
+static double rta_response(unsigned i) {
+    double base = tasks[i].cost + rta_blocking(i);
+    double r = base;
+
+    while (r <= (double)tasks[i].deadline) {
+        double next = base;
+
+        for (unsigned j = 0U; j < task_count; ++j) {
+            if (tasks[j].prio > tasks[i].prio) {
+                next += ceil(r / (double)tasks[j].period - RTA_EPSILON) * tasks[j].cost;
+            }
+        }
+        if (next <= r + RTA_EPSILON) {
+            return next;
+        }
+        r = next;
+    }
+    return r;
+}
+
+static int rta_fp_ok(void) {
+    for (unsigned i = 0U; i < task_count; ++i) {
+        if (rta_response(i) > (double)tasks[i].deadline + RTA_EPSILON) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* SRP blocking at t: a section of a task with D > t on a mutex that a
+* task with D <= t uses
+*/
+static double rta_edf_blocking(double t) {
+    double b = 0.0;
+
+    for (unsigned j = 0U; j < task_count; ++j) {
+        if ((double)tasks[j].deadline <= t) {
+            continue;
+        }
+        for (unsigned m = 0U; m < mutex_count; ++m) {
+            double s = tasks[j].section[m];
+            int shared = npp || tasks[j].server;
+
+            for (unsigned k = 0U; !shared && (k < task_count); ++k) {
+                shared = (tasks[k].section[m] > 0.0) && ((double)tasks[k].deadline <= t);
+            }
+            if ((s > b) && shared) {
+                b = s;
+            }
+        }
+    }
+    return b;
+}
+
+static double rta_demand(double t) {
+    double demand = 0.0;
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        if (t >= (double)tasks[i].deadline) {
+            demand += (floor((t - (double)tasks[i].deadline) / (double)tasks[i].period + RTA_EPSILON) + 1.0)
+                      * tasks[i].cost;
+        }
+    }
+    return demand;
+}
+
+static double rta_utilization(void) {
+    double u = 0.0;
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        u += tasks[i].cost / (double)tasks[i].period;
+    }
+    return u;
+}
+
+/* first absolute deadline with demand + blocking above t, 0 if none */
+static double rta_edf_miss(double *bound, uint32_t *points) {
+    double u = rta_utilization();
+    double limit = 0.0;
+    uint32_t checked = 0U;
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        double slack = (double)(tasks[i].period - tasks[i].deadline);
+
+        limit += slack * tasks[i].cost / (double)tasks[i].period;
+        if ((double)tasks[i].deadline > *bound) {
+            *bound = (double)tasks[i].deadline;
+        }
+    }
+    if (u > 1.0 + RTA_EPSILON) {
+        *points = 0U;
+        return -1.0;
+    }
+    if (u < 1.0 - RTA_EPSILON) {
+        limit /= (1.0 - u);
+        if (limit > *bound) {
+            *bound = limit;
+        }
+    } else {
+        /* U = 1, up to the hyperperiod plus the longest deadline */
+        uint64_t h = 1U;
+        for (unsigned i = 0U; i < task_count; ++i) {
+            uint64_t a = h, b = tasks[i].period;
+            while (b != 0U) {
+                uint64_t r = a % b;
+                a = b;
+                b = r;
+            }
+            h = h / a * tasks[i].period;
+        }
+        *bound += (double)h;
+    }
+
+    /* every absolute deadline up to the bound, in increasing order */
+    for (double t = 0.0; ; ) {
+        double next = HUGE_VAL;
+
+        for (unsigned i = 0U; i < task_count; ++i) {
+            double d = (double)tasks[i].deadline;
+            double k = (t < d) ? 0.0 : floor((t - d) / (double)tasks[i].period + RTA_EPSILON) + 1.0;
+            double at = d + k * (double)tasks[i].period;
+
+            if (at < next) {
+                next = at;
+            }
+        }
+        if ((next > *bound + RTA_EPSILON) || (checked == RTA_MAX_POINTS)) {
+            break;
+        }
+        t = next;
+        ++checked;
+        if (rta_demand(t) + rta_edf_blocking(t) > t + RTA_EPSILON) {
+            *points = checked;
+            return t;
+        }
+    }
+    *points = checked;
+    return 0.0;
+}
+
+static int rta_edf_ok(void) {
+    double bound = 0.0;
+    uint32_t points;
+
+    return rta_edf_miss(&bound, &points) == 0.0;
+}
+
+/* how much C_i can grow (negative: must shrink) with the test passing */
+static double rta_sensitivity(unsigned i, int (*ok)(void)) {
+    double cost = tasks[i].cost;
+    double lo, hi;
+
+    if (ok()) {
+        lo = 0.0;
+        hi = (double)tasks[i].deadline - cost;
+    } else {
+        lo = -cost;
+        hi = 0.0;
+        tasks[i].cost = 0.0;
+        if (!ok()) {
+            tasks[i].cost = cost;
+            return NAN; /* not schedulable even without task i */
+        }
+    }
+    for (unsigned n = 0U; n < 40U; ++n) {
+        double mid = 0.5 * (lo + hi);
+
+        tasks[i].cost = cost + mid;
+        if (ok()) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    tasks[i].cost = cost;
+    return lo;
+}
+
+static void rta_print_sensitivity(double delta, double cost) {
+    if (isnan(delta)) {
+        printf("      -\n");
+    } else {
+        printf(" %+9.3f (%+.0f%%)\n", delta, (cost > 0.0) ? 100.0 * delta / cost : 0.0);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char const *main_c = (char const *)0;
+    double u, bound, miss, hyperbolic = 1.0;
+    uint32_t points = 0U;
+    int fp;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <task set> [main.c] [npp] [NAME=value ...]\n", argv[0]);
+        return 2;
+    }
+    for (int i = 2; i < argc; ++i) {
+        char const *value = strchr(argv[i], '=');
+
+        if (strcmp(argv[i], "npp") == 0) {
+            npp = 1;
+        } else if (value != (char *)0) {
+            /* found before the #define of main.c */
+            if (define_count == RTA_MAX_DEFINES) {
+                rta_fail("too many defines", argv[i]);
+            }
+            snprintf(defines[define_count].name, sizeof(defines[0].name), "%.*s",
+                     (int)(value - argv[i]), argv[i]);
+            defines[define_count++].value = strtol(value + 1, (char **)0, 0);
+        } else {
+            main_c = argv[i];
+        }
+    }
+    if (main_c != (char const *)0) {
+        rta_load_main(main_c);
+    }
+    rta_load_tasks(argv[1], main_c != (char const *)0);
+    rta_expand_loops();
+
+    qsort(tasks, task_count, sizeof(tasks[0]), &rta_compare);
+    for (unsigned i = 0U; i < task_count; ++i) {
+        tasks[i].prio = task_count - i;
+        hyperbolic *= tasks[i].cost / (double)tasks[i].period + 1.0;
+    }
+    u = rta_utilization();
+
+    printf("task set %s", argv[1]);
+    if (main_c != (char const *)0) {
+        printf(", T, D and mutexes from %s", main_c);
+    }
+    printf("\n%u tasks, U = %.3f, blocking: %s\n", task_count, u,
+           npp ? "NPP (sem_down)" : "priority ceiling (mutex_t), NPP for the server");
+    for (unsigned m = 0U; m < mutex_count; ++m) {
+        unsigned c = rta_ceiling(m);
+        printf("  %s: ceiling %s\n", mutexes[m],
+               (c != 0U) ? tasks[task_count - c].name : "-");
+    }
+
+    printf("\nfixed priority, response-time analysis\n");
+    printf("%4s %-24s %8s %6s %6s %8s %8s   %s\n",
+           "prio", "task", "C", "T", "D", "B", "R", "C may grow by");
+    fp = rta_fp_ok();
+    for (unsigned i = 0U; i < task_count; ++i) {
+        double r = rta_response(i);
+
+        printf("%4u %-24s %8.3f %6u %6u %8.3f ", tasks[i].prio, tasks[i].name,
+               tasks[i].cost, (unsigned)tasks[i].period, (unsigned)tasks[i].deadline,
+               rta_blocking(i));
+        if (r > (double)tasks[i].deadline + RTA_EPSILON) {
+            printf("%8s ", "> D");
+        } else {
+            printf("%8.3f ", r);
+        }
+        rta_print_sensitivity(rta_sensitivity(i, &rta_fp_ok), tasks[i].cost);
+    }
+    printf("Liu-Layland: U = %.3f %s n(2^(1/n)-1) = %.3f (sufficient, D = T)\n", u,
+           (u <= task_count * (pow(2.0, 1.0 / task_count) - 1.0)) ? "<=" : ">",
+           task_count * (pow(2.0, 1.0 / task_count) - 1.0));
+    printf("hyperbolic : prod(U_i+1) = %.3f %s 2 (sufficient, D = T)\n", hyperbolic,
+           (hyperbolic <= 2.0) ? "<=" : ">");
+    printf("exact RTA  : %s\n", fp ? "schedulable" : "NOT schedulable");
+
+    printf("\nEDF, processor demand\n");
+    bound = 0.0;
+    miss = rta_edf_miss(&bound, &points);
+    if (miss < 0.0) {
+        printf("U > 1: NOT schedulable\n");
+    } else if (miss > 0.0) {
+        printf("demand %.3f + blocking %.3f > t at t = %.0f: NOT schedulable\n",
+               rta_demand(miss), rta_edf_blocking(miss), miss);
+    } else {
+        printf("%u deadlines up to t = %.0f: schedulable\n", (unsigned)points, bound);
+    }
+    printf("%-24s   %s\n", "task", "C may grow by");
+    for (unsigned i = 0U; i < task_count; ++i) {
+        printf("%-24s ", tasks[i].name);
+        rta_print_sensitivity(rta_sensitivity(i, &rta_edf_ok), tasks[i].cost);
+    }
+    return (fp ? 0 : 1);
+}
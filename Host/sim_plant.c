@@ -0,0 +1,395 @@
+/****************************************************************************
+* Closed-loop simulation of the ball-in-tube plant, without the hardware.
+*
+* The sensor -> PID tasks of fan_loop.c run on the kernel in virtual time
+* (1 tick = 1 ms), against a model of the plant that SysTick_Handler
+* integrates every tick:
+*   - timer  : calc_PID writes the dithered pattern of pwm_dither.c, and
+*              the DMA copies one value to CCR1 per PWM period,
+*              SIM_PWM_PER_TICK periods per tick
+*   - fan    : first-order lag from the duty (CCR1 / (ARR + 1)) to the
+*              air speed in the tube, proportional to the fan speed; with
+*              -DSIM_AIR_LOSS=<fraction> it is that much lower at the top
+*              of the tube than at the bottom, so the hover duty grows
+*              with the height (0 by default, the model the gains of
+*              fan_loop.h were tuned on)
+*   - ball   : m dv/dt = 1/2 rho Cd A (v_air - v)|v_air - v| - m g, stopped
+*              at both ends of the tube
+*   - sensor : VL53L0X at the top of the tube, a range every
+*              SIM_SENSOR_PERIOD ticks (the timing budget) averaged over
+*              the ranging window, plus Gaussian noise, then the data-ready
+*              interrupt releases read_distance_sensor
+* The tasks, the PID, its gains and the build options are the ones of the
+* board (fan_loop.h), on loop 0; they call the mock of
+* VL53L0X_readRangeContinuousMillimetersDMA below and Host/VL53L0X.h in
+* place of the sensor driver.
+*
+* The ball starts at rest at the bottom and is lifted to 200 mm, then the
+* button is "pressed" every SIM_STEP_TICKS to toggle the setpoint between
+* 200 and 400 mm, through the aperiodic task and the polling server as on
+* the board. For every step the program measures the overshoot (% of the
+* step), the settling time into +-SIM_BAND_MM of the setpoint, and the
+* mean error over the last second. It exits with status 1 if a step does
+* not settle within SIM_MAX_SETTLING_S or overshoots more than
+* SIM_MAX_OVERSHOOT, so a controller regression fails the run.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DPID_FIXED_POINT] -IHost -IInc \
+*       [-DPID_GAIN_SCHEDULE] [-DSIM_AIR_LOSS=<fraction>] \
+*       Src/miros.c Src/fan_loop.c Src/pid.c Src/pid_fixed.c Src/pwm_dither.c \
+*       Src/pid_schedule.c Src/pid_schedule_table.c \
+*       Host/miros_port_posix.c Host/sim_plant.c -lm -o sim_plant
+*
+* usage: sim_plant [steps] [noise mm] [seed]
+****************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_sporadic.h"
+#include "miros_server.h"
+#include "miros_ceiling.h"
+#include "miros_chain.h"
+#include "fan_loop.h"
+#include "pwm_dither.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+#ifdef MIROS_TICKLESS
+#error "the plant is integrated in every tick, build without MIROS_TICKLESS"
+#endif
+#if LOOP_COUNT != 1
+#error "one tube is simulated, build without LOOP_COUNT"
+#endif
+
+#define SIM_STACK_SIZE (64U * 1024U)
+#define SIM_TICK_S 0.001            /* s per tick */
+#define SIM_SUBSTEPS 4U             /* plant integration steps per tick */
+#define SIM_PWM_PER_TICK 2U         /* PWM periods per tick, 2 kHz */
+#define SIM_STEP_TICKS 8000U        /* between two setpoint changes */
+#define SIM_SENSOR_PERIOD DISTANCE_SENSOR_TIMING_BUDGET /* ticks */
+#define SIM_BAND_MM 15.0            /* settled within +-SIM_BAND_MM */
+#define SIM_MAX_SETTLING_S 6.0
+#define SIM_MAX_OVERSHOOT 45.0      /* % of the step */
+
+/* plant */
+#define SIM_TUBE_M 0.60             /* sensor to the bottom of the tube */
+#define SIM_BALL_KG 0.0027          /* ping-pong ball */
+#define SIM_BALL_AREA (3.14159265 * 0.02 * 0.02)
+#define SIM_DRAG_CD 0.47
+#define SIM_AIR_RHO 1.2
+#define SIM_G 9.81
+#define SIM_FAN_TAU_S 0.15          /* fan speed time constant */
+#define SIM_HOVER_DUTY PWM_OFFSET   /* mid-tube */
+#ifndef SIM_AIR_LOSS
+#define SIM_AIR_LOSS 0.0            /* of the air speed, bottom to top */
+#endif
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[SIM_STACK_SIZE / sizeof(uint64_t)];
+} sim_task;
+
+/* ---------------------------------------------------------------------- */
+/* mock of the sensor driver */
+
+uint16_t VL53L0X_readRangeContinuousMillimetersDMA(struct VL53L0X *dev) {
+    return dev->range;
+}
+
+/* ---------------------------------------------------------------------- */
+/* the tasks of fan_loop.c, started as in main.c */
+
+sim_task struct_distance_sensor_task;
+sim_task struct_calc_pid;
+sim_task struct_aperiodic_task;
+
+OSThread_periodics_task_parameters parameters_distance_sensor_task;
+OSThread_periodics_task_parameters parameters_calc_pid;
+
+uint16_t fanCcr[PWM_DITHER_PERIODS];
+
+/* ---------------------------------------------------------------------- */
+/* plant */
+
+typedef struct {
+    double height; /* of the ball above the bottom, m */
+    double speed;  /* of the ball, m/s, up */
+    double fan;    /* fan speed, in duty units */
+} sim_plant;
+
+typedef struct {
+    double from;       /* setpoint before the step, mm */
+    double to;
+    uint32_t start;    /* tick of the button press */
+    double peak;       /* furthest distance past 'to', mm */
+    uint32_t last_out; /* last tick outside the band */
+    double error_sum;  /* |error| over the last second */
+    uint32_t error_n;
+} sim_step;
+
+static sim_plant plant = { 0.0, 0.0, 0.0 };
+static double sim_duty;  /* in CCR1 */
+static uint32_t sim_dma; /* next fanCcr the DMA copies */
+static sim_step step;
+static uint32_t uwTick;
+static uint32_t sim_steps = 20U;
+static uint32_t steps_done;
+static double noise_mm = 2.0;
+static double window_sum; /* distance over the ranging window, mm */
+static double settling_max, settling_sum;
+static double overshoot_max, overshoot_sum;
+static double error_max;
+static uint32_t failures;
+static struct timespec started;
+static uint64_t stack_idleThread[SIM_STACK_SIZE / sizeof(uint64_t)];
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+static uint32_t sim_state = 2463534242U;
+
+static double sim_uniform(void) {
+    sim_state ^= sim_state << 13;
+    sim_state ^= sim_state >> 17;
+    sim_state ^= sim_state << 5;
+    return ((double)sim_state + 1.0) / 4294967297.0;
+}
+
+static double sim_gauss(void) {
+    return sqrt(-2.0 * log(sim_uniform())) * cos(2.0 * 3.14159265 * sim_uniform());
+}
+
+static double sim_distance_mm(void) {
+    return (SIM_TUBE_M - plant.height) * 1000.0;
+}
+
+/* air speed per unit of fan speed, that holds the ball at SIM_HOVER_DUTY
+* in the middle of the tube
+*/
+static double sim_air_gain(double height) {
+    double k = 0.5 * SIM_AIR_RHO * SIM_DRAG_CD * SIM_BALL_AREA;
+    double profile = (1.0 - SIM_AIR_LOSS * height / SIM_TUBE_M) / (1.0 - SIM_AIR_LOSS / 2.0);
+
+    return sqrt(SIM_BALL_KG * SIM_G / k) / SIM_HOVER_DUTY * profile;
+}
+
+static void sim_plant_step(double dt, double duty) {
+    double k = 0.5 * SIM_AIR_RHO * SIM_DRAG_CD * SIM_BALL_AREA;
+    double relative = sim_air_gain(plant.height) * plant.fan - plant.speed;
+    double force = k * relative * fabs(relative) - SIM_BALL_KG * SIM_G;
+
+    plant.fan += (duty - plant.fan) * dt / SIM_FAN_TAU_S;
+    plant.speed += force / SIM_BALL_KG * dt;
+    plant.height += plant.speed * dt;
+
+    /* the ends of the tube stop the ball */
+    if (plant.height < 0.0) {
+        plant.height = 0.0;
+        plant.speed = 0.0;
+    } else if (plant.height > SIM_TUBE_M) {
+        plant.height = SIM_TUBE_M;
+        plant.speed = 0.0;
+    }
+}
+
+static void sim_step_begin(double from, double to) {
+    step.from = from;
+    step.to = to;
+    step.start = uwTick;
+    step.peak = 0.0;
+    step.last_out = uwTick;
+    step.error_sum = 0.0;
+    step.error_n = 0U;
+}
+
+static void sim_step_end(void) {
+    double size = fabs(step.to - step.from);
+    double overshoot = 100.0 * step.peak / size;
+    double settling = (double)(step.last_out - step.start) * SIM_TICK_S;
+    double error = step.error_sum / (double)step.error_n;
+    int settled = (uwTick - step.last_out) > 1U;
+
+    if (!settled || (settling > SIM_MAX_SETTLING_S) || (overshoot > SIM_MAX_OVERSHOOT)) {
+        ++failures;
+        printf("step %u: %.0f -> %.0f mm, overshoot %.1f%%, settling %s%.2f s: FAIL\n",
+               (unsigned)steps_done, step.from, step.to, overshoot,
+               settled ? "" : "> ", settling);
+    }
+    settling_sum += settling;
+    overshoot_sum += overshoot;
+    if (settling > settling_max) {
+        settling_max = settling;
+    }
+    if (overshoot > overshoot_max) {
+        overshoot_max = overshoot;
+    }
+    if (error > error_max) {
+        error_max = error;
+    }
+    ++steps_done;
+}
+
+static void sim_report(void) {
+    struct timespec now;
+    double elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (double)(now.tv_sec - started.tv_sec)
+              + (double)(now.tv_nsec - started.tv_nsec) * 1e-9;
+
+#ifdef PID_FIXED_POINT
+    printf("PID_fixed_action, ");
+#else
+    printf("PID_action (float), ");
+#endif
+#ifdef PID_GAIN_SCHEDULE
+    printf("gain scheduled, ");
+#endif
+    printf("%u steps of %.0f s, sensor noise %.1f mm, in %.2f s (%.0f steps/s)\n",
+           (unsigned)steps_done, SIM_STEP_TICKS * SIM_TICK_S, noise_mm, elapsed,
+           (double)steps_done / elapsed);
+    printf("settling into +-%.0f mm: mean %.2f max %.2f s (limit %.1f)\n",
+           SIM_BAND_MM, settling_sum / steps_done, settling_max, SIM_MAX_SETTLING_S);
+    printf("overshoot          : mean %.1f max %.1f %% (limit %.0f)\n",
+           overshoot_sum / steps_done, overshoot_max, SIM_MAX_OVERSHOOT);
+    printf("steady-state error : max %.1f mm (mean |e| over the last second)\n",
+           error_max);
+    printf("%u of %u steps failed\n", (unsigned)failures, (unsigned)steps_done);
+    exit((failures == 0U) ? 0 : 1);
+}
+
+void SysTick_Handler(void) {
+    double distance;
+    double error;
+
+    /* one DMA transfer to CCR1 per update event */
+    for (unsigned i = 0U; i < SIM_SUBSTEPS; ++i) {
+        if ((i % (SIM_SUBSTEPS / SIM_PWM_PER_TICK)) == 0U) {
+            sim_duty = (double)fanCcr[sim_dma] / PWM_PERIOD;
+            sim_dma = (sim_dma + 1U) % PWM_DITHER_PERIODS;
+        }
+        sim_plant_step(SIM_TICK_S / SIM_SUBSTEPS, sim_duty);
+    }
+    HAL_IncTick();
+
+    /* step response */
+    distance = sim_distance_mm();
+    error = distance - step.to;
+    if (((step.to - step.from) * error > 0.0) && (fabs(error) > step.peak)) {
+        step.peak = fabs(error); /* past the setpoint, away from where it came */
+    }
+    if (fabs(error) > SIM_BAND_MM) {
+        step.last_out = uwTick;
+    }
+    if (uwTick - step.start > SIM_STEP_TICKS - 1000U) {
+        step.error_sum += fabs(error);
+        step.error_n++;
+    }
+
+    /* range over the window, latched on data-ready */
+    window_sum += distance;
+    if ((uwTick % SIM_SENSOR_PERIOD) == 0U) {
+        double range = window_sum / SIM_SENSOR_PERIOD + noise_mm * sim_gauss();
+
+        loops[0].sensor.range = (uint16_t)((range < 0.0) ? 0.0 : (range + 0.5));
+        window_sum = 0.0;
+        OS_sporadic_release(&struct_distance_sensor_task.TCB_thread);
+    }
+
+    OS_tick();
+
+    /* the button toggles the setpoint */
+    if (uwTick - step.start == SIM_STEP_TICKS) {
+        if (step.from < SIM_TUBE_M * 1000.0) {
+            sim_step_end(); /* the lift-off from the bottom is not a step */
+        }
+        if (steps_done == sim_steps) {
+            sim_report();
+        }
+        sim_step_begin(step.to, (step.to == 400.0) ? 200.0 : 400.0);
+        Q_ASSERT(!aperiodic_task_armed); /* the last toggle has ended */
+        aperiodic_task_armed = 1U;
+        OSAperiodic_task_start(&struct_aperiodic_task.TCB_thread,
+                               &aperiodic_task,
+                               struct_aperiodic_task.stack_thread,
+                               sizeof(struct_aperiodic_task.stack_thread));
+    }
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+}
+
+void OS_onIdle(void) {
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        sim_steps = (uint32_t)strtoul(argv[1], (char **)0, 10);
+    }
+    if (argc > 2) {
+        noise_mm = strtod(argv[2], (char **)0);
+    }
+    if ((argc > 3) && (strtoul(argv[3], (char **)0, 10) != 0U)) {
+        sim_state = (uint32_t)strtoul(argv[3], (char **)0, 10);
+    }
+    Q_REQUIRE(sim_steps != 0U);
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    mutex_init(&mutex_setpoint);
+    fan_loop_init(&loops[0], &struct_distance_sensor_task.TCB_thread,
+                  &struct_calc_pid.TCB_thread, fanCcr, 1U);
+
+    parameters_distance_sensor_task.deadline_absolute = 5;
+    parameters_distance_sensor_task.deadline_dinamic = 5;
+    parameters_distance_sensor_task.period_absolute = DISTANCE_SENSOR_MIN_INTERARRIVAL;
+    parameters_distance_sensor_task.period_dinamic = DISTANCE_SENSOR_MIN_INTERARRIVAL;
+
+    parameters_calc_pid.deadline_absolute = 5;
+    parameters_calc_pid.deadline_dinamic = 5;
+    parameters_calc_pid.period_absolute = DISTANCE_SENSOR_MIN_INTERARRIVAL;
+    parameters_calc_pid.period_dinamic = DISTANCE_SENSOR_MIN_INTERARRIVAL;
+
+    struct_distance_sensor_task.TCB_thread.task_parameters = &parameters_distance_sensor_task;
+    struct_calc_pid.TCB_thread.task_parameters = &parameters_calc_pid;
+
+    OSSporadic_task_start(&struct_distance_sensor_task.TCB_thread,
+                          &read_distance_sensor,
+                          struct_distance_sensor_task.stack_thread,
+                          sizeof(struct_distance_sensor_task.stack_thread));
+    OSSporadic_task_start(&struct_calc_pid.TCB_thread,
+                          &calc_PID,
+                          struct_calc_pid.stack_thread,
+                          sizeof(struct_calc_pid.stack_thread));
+
+    OS_chain_link(&struct_distance_sensor_task.TCB_thread, &struct_calc_pid.TCB_thread);
+    mutex_use(&mutex_setpoint, &struct_calc_pid.TCB_thread);
+
+    OS_server_start(OS_SERVER_POLLING, APERIODIC_SERVER_CAPACITY, APERIODIC_SERVER_PERIOD);
+
+    /* the ball rests at the bottom, the first step goes to 200 mm */
+    sim_step_begin(SIM_TUBE_M * 1000.0, 200.0);
+    OS_run();
+}
@@ -0,0 +1,408 @@
+/****************************************************************************
+* Schedule simulator: runs a task set on the MiROS kernel in virtual time.
+*
+* The task set is read from a text file, one task per line:
+*
+*   name  C  T  D  [C_min  [J]]
+*
+* in ticks: worst-case execution time C, period T, relative deadline D,
+* and optionally the best-case execution time C_min (each job executes a
+* uniformly distributed time in [C_min, C]) and a release jitter J. A task
+* without jitter is a periodic task released by OS_tick from tick 0. A task
+* with jitter is a sporadic task with a minimum inter-arrival time of T - J
+* (so D <= T - J), released by the simulator on tick k*T + U[0, J] from
+* tick T on. Lines starting with '#' are comments.
+*
+* The kernel is the real one (OSPeriodic_task_start, OS_tick, OS_sched,
+* the deadline monitoring), linked with the POSIX port. Every job
+* "executes" by raising the virtual tick itself, and SysTick_Handler
+* charges each tick to the thread that ran in it, as in
+* Host/bench_bandwidth.c. The program prints:
+*   - a Gantt chart of the first ticks: '#' ran in the tick, '-' had a job
+*     released but did not run
+*   - per task: jobs, deadline misses, releases skipped while late, worst
+*     lateness, and the response times (release to completion, rounded up
+*     to the tick) min/mean/p99/max
+*   - a response-time histogram per task
+* Build with -DMIROS_EDF to simulate the EDF scheduler.
+*
+* Provides its own SysTick_Handler/OS_onIdle instead of bsp_posix.c:
+*   gcc -O2 -DMIROS_PORT_POSIX [-DMIROS_EDF] -IHost -IInc \
+*       Src/miros.c Host/miros_port_posix.c Host/sim_sched.c -o sim_sched
+*
+* usage: sim_sched <task set> [ticks] [gantt ticks] [seed]
+****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_deadline.h"
+#include "miros_sporadic.h"
+#include "qassert.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+#ifdef MIROS_TICKLESS
+#error "the jittered releases need every tick, build without MIROS_TICKLESS"
+#endif
+
+#define SIM_STACK_SIZE (64U * 1024U)
+#define SIM_MAX_TASKS 10U  /* NUM_MAX_PERIODIC_TASKS in Src/miros.c */
+#define SIM_MAX_GANTT 200U /* columns */
+#define SIM_MAX_RESPONSE 4096U
+#define SIM_HISTOGRAM_ROWS 16U
+
+typedef struct {
+    OSThread TCB_thread;
+    uint64_t stack_thread[SIM_STACK_SIZE / sizeof(uint64_t)];
+    OSThread_periodics_task_parameters parameters;
+    char name[24];
+    uint32_t cost_max; /* C */
+    uint32_t cost_min;
+    uint32_t period;   /* T */
+    uint32_t deadline; /* D */
+    uint32_t jitter;   /* J */
+    uint32_t cost;     /* of the current job */
+    uint32_t executed; /* ticks charged to the current job */
+    uint32_t release;  /* tick of the current job release */
+    uint32_t arrival;  /* jittered: tick of the next release */
+    uint32_t nominal;  /* jittered: k*T of the next release */
+    uint32_t responses[SIM_MAX_RESPONSE + 1U]; /* count by ticks, last = more */
+    uint32_t jobs;
+    uint32_t response_max;
+    uint64_t response_sum;
+    char gantt[SIM_MAX_GANTT + 1U];
+} sim_task;
+
+extern uint32_t OS_waiting_next_periodSet;
+
+static sim_task tasks[SIM_MAX_TASKS];
+static unsigned task_count;
+static uint64_t stack_idleThread[SIM_STACK_SIZE / sizeof(uint64_t)];
+
+static uint32_t sim_ticks = 1000000U;
+static uint32_t gantt_ticks = 80U;
+static uint32_t uwTick;
+static struct timespec started;
+static char const *taskset;
+
+void HAL_IncTick(void) {
+    ++uwTick;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+static uint32_t sim_state = 2463534242U;
+
+static uint32_t sim_rand(void) {
+    sim_state ^= sim_state << 13;
+    sim_state ^= sim_state >> 17;
+    sim_state ^= sim_state << 5;
+    return sim_state;
+}
+
+static uint32_t sim_gcd(uint32_t a, uint32_t b) {
+    while (b != 0U) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+static uint32_t sim_bit(sim_task const *t) {
+    return 1U << (t->TCB_thread.prio - 1U);
+}
+
+/* smallest response time with at least p percent of the jobs at or below */
+static uint32_t sim_percentile(sim_task const *t, uint32_t p) {
+    uint64_t rank = ((uint64_t)p * t->jobs + 99U) / 100U;
+    uint64_t seen = 0U;
+
+    for (uint32_t r = 0U; r <= SIM_MAX_RESPONSE; ++r) {
+        seen += t->responses[r];
+        if ((seen >= rank) && (seen != 0U)) {
+            return r;
+        }
+    }
+    return t->response_max;
+}
+
+static void sim_histogram(sim_task const *t) {
+    uint32_t top = (t->response_max < SIM_MAX_RESPONSE) ? t->response_max : SIM_MAX_RESPONSE;
+    uint32_t width = (top + SIM_HISTOGRAM_ROWS) / SIM_HISTOGRAM_ROWS;
+    uint32_t rows[SIM_HISTOGRAM_ROWS + 1U] = { 0U };
+    uint32_t most = 1U;
+
+    for (uint32_t r = 0U; r <= SIM_MAX_RESPONSE; ++r) {
+        uint32_t row = (r > top) ? SIM_HISTOGRAM_ROWS : r / width;
+        rows[row] += t->responses[r];
+    }
+    for (uint32_t i = 0U; i <= SIM_HISTOGRAM_ROWS; ++i) {
+        if (rows[i] > most) {
+            most = rows[i];
+        }
+    }
+    printf("\n%s, response time (ticks), D = %u\n", t->name, (unsigned)t->deadline);
+    for (uint32_t i = 0U; i <= SIM_HISTOGRAM_ROWS; ++i) {
+        if (rows[i] == 0U) {
+            continue;
+        }
+        if (i == SIM_HISTOGRAM_ROWS) {
+            printf("  >%-8u", (unsigned)SIM_MAX_RESPONSE);
+        } else if (width == 1U) {
+            printf("  %-9u", (unsigned)i);
+        } else {
+            printf("  %4u-%-4u", (unsigned)(i * width), (unsigned)(i * width + width - 1U));
+        }
+        printf(" %10u %s|", (unsigned)rows[i],
+               ((i + 1U) * width - 1U > t->deadline) ? "!" : " ");
+        for (uint32_t n = 0U; n < (uint32_t)((uint64_t)rows[i] * 50U / most); ++n) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+static void sim_report(void) {
+    struct timespec now;
+    double utilization = 0.0;
+    uint32_t hyperperiod = 1U;
+    double elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (double)(now.tv_sec - started.tv_sec)
+              + (double)(now.tv_nsec - started.tv_nsec) * 1e-9;
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        utilization += (double)tasks[i].cost_max / (double)tasks[i].period;
+        hyperperiod = hyperperiod / sim_gcd(hyperperiod, tasks[i].period) * tasks[i].period;
+    }
+#ifdef MIROS_EDF
+    printf("task set %s, EDF, %u tasks, U = %.3f, hyperperiod %u ticks\n",
+#else
+    printf("task set %s, RM, %u tasks, U = %.3f, hyperperiod %u ticks\n",
+#endif
+           taskset, task_count, utilization, (unsigned)hyperperiod);
+    printf("%u ticks (%.0f hyperperiods) in %.2f s\n\n", (unsigned)uwTick,
+           (double)uwTick / (double)hyperperiod, elapsed);
+
+    printf("gantt, ticks 0-%u: '#' running, '-' released and waiting\n",
+           (unsigned)(gantt_ticks - 1U));
+    for (unsigned i = 0U; i < task_count; ++i) {
+        printf("%-20s|%s|\n", tasks[i].name, tasks[i].gantt);
+    }
+
+    printf("\n%-20s %4s %4s %4s %9s %7s %7s %5s %5s %7s %5s %5s\n",
+           "task", "C", "T", "D", "jobs", "misses", "skipped", "late",
+           "R min", "mean", "p99", "max");
+    for (unsigned i = 0U; i < task_count; ++i) {
+        sim_task const *t = &tasks[i];
+        OSThread_deadline_stats const *stats = OS_deadline_stats_get(&t->TCB_thread);
+
+        printf("%-20s %4u %4u %4u %9u %7u %7u %5u %5u %7.2f %5u %5u\n",
+               t->name, (unsigned)t->cost_max, (unsigned)t->period,
+               (unsigned)t->deadline, (unsigned)t->jobs, (unsigned)stats->misses,
+               (unsigned)stats->skipped, (unsigned)stats->lateness_max,
+               (unsigned)sim_percentile(t, 0U),
+               (t->jobs != 0U) ? (double)t->response_sum / (double)t->jobs : 0.0,
+               (unsigned)sim_percentile(t, 99U), (unsigned)t->response_max);
+    }
+    for (unsigned i = 0U; i < task_count; ++i) {
+        sim_histogram(&tasks[i]);
+    }
+    exit(0);
+}
+
+/* next release of a jittered task, k*T + U[0, J] */
+static void sim_next_arrival(sim_task *t) {
+    t->nominal += t->period;
+    t->arrival = t->nominal + sim_rand() % (t->jitter + 1U);
+}
+
+void SysTick_Handler(void) {
+    uint32_t waiting = OS_waiting_next_periodSet;
+
+    /* charge the elapsed tick to the job that ran in it */
+    for (unsigned i = 0U; i < task_count; ++i) {
+        sim_task *t = &tasks[i];
+
+        if (OS_curr == &t->TCB_thread) {
+            ++t->executed;
+        }
+        if (uwTick < gantt_ticks) {
+            t->gantt[uwTick] = (OS_curr == &t->TCB_thread) ? '#'
+                             : (((waiting & sim_bit(t)) == 0U) ? '-' : ' ');
+        }
+    }
+
+    HAL_IncTick();
+    OS_tick();
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        sim_task *t = &tasks[i];
+
+        if ((t->jitter != 0U) && (t->arrival == uwTick)) {
+            OS_sporadic_release(&t->TCB_thread);
+            sim_next_arrival(t);
+        }
+        /* released on this tick, by the wheel or by the arrival */
+        if (((waiting & ~OS_waiting_next_periodSet) & sim_bit(t)) != 0U) {
+            t->release = uwTick;
+        }
+    }
+
+    if (uwTick >= sim_ticks) {
+        sim_report();
+    }
+
+    __disable_irq();
+    OS_sched();
+    __enable_irq();
+}
+
+void OS_onStartup(void) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+}
+
+void OS_onIdle(void) {
+    OS_port_tick();
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
+
+static sim_task *sim_self(void) {
+    for (unsigned i = 0U; i < task_count; ++i) {
+        if (OS_curr == &tasks[i].TCB_thread) {
+            return &tasks[i];
+        }
+    }
+    Q_ERROR();
+    return (sim_task *)0;
+}
+
+static void sim_job(void) {
+    sim_task *me = sim_self();
+
+    while (1) {
+        uint32_t response;
+
+        me->executed = 0U;
+        me->cost = me->cost_min + sim_rand() % (me->cost_max - me->cost_min + 1U);
+
+        /* run until the job has one tick left, the last one is taken
+        * when it ends
+        */
+        while (me->executed + 1U < me->cost) {
+            OS_port_tick();
+        }
+        __disable_irq();
+        OS_port_tick();
+
+        /* completes in the tick after uwTick, rounded up */
+        response = uwTick + 1U - me->release;
+        me->responses[(response < SIM_MAX_RESPONSE) ? response : SIM_MAX_RESPONSE]++;
+        if (response > me->response_max) {
+            me->response_max = response;
+        }
+        me->response_sum += response;
+        me->jobs++;
+
+        OS_wait_next_period();
+    }
+}
+
+static void sim_load(char const *path) {
+    char line[256];
+    FILE *f = fopen(path, "r");
+
+    if (f == (FILE *)0) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), f) != (char *)0) {
+        sim_task *t = &tasks[task_count];
+        unsigned c, p, d, c_min, j;
+        int n;
+
+        if ((line[0] == '#') || (strspn(line, " \t\r\n") == strlen(line))) {
+            continue;
+        }
+        if (task_count == SIM_MAX_TASKS) {
+            fprintf(stderr, "%s: more than %u tasks\n", path, SIM_MAX_TASKS);
+            exit(2);
+        }
+        n = sscanf(line, "%23s %u %u %u %u %u", t->name, &c, &p, &d, &c_min, &j);
+        if (n < 4) {
+            fprintf(stderr, "%s: expected 'name C T D [C_min [J]]': %s", path, line);
+            exit(2);
+        }
+        t->cost_max = c;
+        t->cost_min = (n > 4) ? c_min : c;
+        t->period = p;
+        t->deadline = d;
+        t->jitter = (n > 5) ? j : 0U;
+        if ((t->cost_min == 0U) || (t->cost_min > t->cost_max)
+            || (d == 0U) || (t->jitter >= p) || (d > p - t->jitter)) {
+            fprintf(stderr, "%s: need 0 < C_min <= C and 0 < D <= T - J: %s", path, line);
+            exit(2);
+        }
+        ++task_count;
+    }
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <task set> [ticks] [gantt ticks] [seed]\n", argv[0]);
+        return 2;
+    }
+    taskset = argv[1];
+    if (argc > 2) {
+        sim_ticks = (uint32_t)strtoul(argv[2], (char **)0, 10);
+    }
+    if (argc > 3) {
+        gantt_ticks = (uint32_t)strtoul(argv[3], (char **)0, 10);
+        if (gantt_ticks > SIM_MAX_GANTT) {
+            gantt_ticks = SIM_MAX_GANTT;
+        }
+    }
+    if ((argc > 4) && (strtoul(argv[4], (char **)0, 10) != 0U)) {
+        sim_state = (uint32_t)strtoul(argv[4], (char **)0, 10);
+    }
+    if (gantt_ticks > sim_ticks) {
+        gantt_ticks = sim_ticks;
+    }
+    sim_load(taskset);
+
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+
+    for (unsigned i = 0U; i < task_count; ++i) {
+        sim_task *t = &tasks[i];
+
+        memset(t->gantt, ' ', gantt_ticks);
+        t->parameters.period_absolute = t->period - t->jitter;
+        t->parameters.deadline_absolute = t->deadline;
+        t->parameters.period_dinamic = t->period;
+        t->parameters.deadline_dinamic = t->deadline;
+        t->TCB_thread.task_parameters = &t->parameters;
+        if (t->jitter == 0U) {
+            OSPeriodic_task_start(&t->TCB_thread, &sim_job,
+                                  t->stack_thread, sizeof(t->stack_thread));
+        } else {
+            OSSporadic_task_start(&t->TCB_thread, &sim_job,
+                                  t->stack_thread, sizeof(t->stack_thread));
+            sim_next_arrival(t);
+        }
+    }
+    OS_run();
+}
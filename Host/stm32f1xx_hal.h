@@ -0,0 +1,16 @@
+/****************************************************************************
+* Host stand-in for the STM32 HAL header pulled in by miros.h.
+*
+* Only the HAL services the kernel and the host programs use are declared,
+* they are implemented by the POSIX board support (bsp_posix.c).
+****************************************************************************/
+#ifndef __STM32F1xx_HAL_H
+#define __STM32F1xx_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+void HAL_IncTick(void);
+uint32_t HAL_GetTick(void);
+
+#endif /* __STM32F1xx_HAL_H */
@@ -0,0 +1,31 @@
+/****************************************************************************
+* VL53L0X range read over the I2C1 DMA transport (i2c_dma.h)
+****************************************************************************/
+#ifndef VL53L0X_DMA_H
+#define VL53L0X_DMA_H
+
+#include <stdint.h>
+#include "VL53L0X.h"
+
+/* The 8-bit address of struct VL53L0X (0x52 after reset, main.c) as the
+* 7-bit one of i2c_xfer. Every sensor on the bus needs its own: see
+* VL53L0X_assign_address().
+*/
+#define VL53L0X_DEFAULT_ADDRESS 0x52U
+#define VL53L0X_I2C_ADDRESS_OF(dev) ((uint8_t) ((dev)->address >> 1))
+
+/* Same as VL53L0X_readRangeContinuousMillimeters, but the register read
+* and the SYSTEM_INTERRUPT_CLEAR write go out as one i2c_submit job and
+* the calling task is blocked while the bus is busy. Returns 65535 and
+* sets did_timeout if the sensor does not answer.
+*/
+uint16_t VL53L0X_readRangeContinuousMillimetersDMA(struct VL53L0X *dev);
+
+/* Move a sensor that answers at dev->address to the 8-bit 'address'
+* (I2C_SLAVE_DEVICE_ADDRESS, volatile until the next XSHUT or power
+* cycle) and update dev->address. Blocking, for the boot sequence before
+* i2c_dma_init(), while the other sensors are held in reset.
+*/
+void VL53L0X_assign_address(struct VL53L0X *dev, uint8_t address);
+
+#endif /* VL53L0X_DMA_H */
@@ -0,0 +1,119 @@
+/****************************************************************************
+* Control loops of the ball-in-tube rig: the sensor -> PID tasks, the
+* button job and their constants
+*
+* Each loop has its own tube, VL53L0X and TIM2 channel. main.c starts the
+* tasks of loop i on the board, Host/sim_plant.c runs the same bodies on
+* the POSIX port against a model of the plant, with a mock of
+* VL53L0X_readRangeContinuousMillimetersDMA. A task body finds its loop
+* from the running thread, so every loop runs the same functions:
+*   - read_distance_sensor: sporadic, released by the data-ready line,
+*                           writes the range to the loop's channel
+*   - calc_PID            : chained after it, PID of the last range and
+*                           the dithered fan duty
+*   - aperiodic_task      : the button, toggles the setpoints between
+*                           200 and 400 mm through the polling server
+* Host/rta.c reads the #defines below through the #include of main.c.
+****************************************************************************/
+#ifndef FAN_LOOP_H
+#define FAN_LOOP_H
+
+#include <stdint.h>
+#include "miros.h"
+#include "miros_ceiling.h"
+#include "miros_channel.h"
+#include "miros_trace.h"
+#include "pid.h"
+#include "pid_fixed.h"
+#include "pwm_dither.h"
+#include "VL53L0X_dma.h"
+
+/* build with -DLOOP_COUNT=n for up to 4, one per TIM2 channel */
+#ifndef LOOP_COUNT
+#define LOOP_COUNT 1
+#endif
+#if (LOOP_COUNT < 1) || (LOOP_COUNT > 4)
+#error "LOOP_COUNT must be 1 to 4, one loop per TIM2 channel"
+#endif
+
+/* the most loops Host/rta.c finds schedulable with the costs in
+* Host/tasksets/main_costs.txt. They are estimates, and they pass with
+* one loop only; raise it once the costs measured with -DMIROS_TRACE are
+* in the file and ./rta Host/tasksets/main_costs.txt Src/main.c
+* LOOP_COUNT=n passes
+*/
+#define LOOP_COUNT_SCHEDULABLE 1
+#if LOOP_COUNT > LOOP_COUNT_SCHEDULABLE
+#error "LOOP_COUNT is not schedulable with Host/tasksets/main_costs.txt (README)"
+#endif
+
+/* one sample per timing budget, in ms (ticks) */
+#define DISTANCE_SENSOR_TIMING_BUDGET 20
+
+/* minimum time between two samples, in ticks, below the 20 ms timing
+* budget so that a sample arriving a little early is not deferred
+*/
+#define DISTANCE_SENSOR_MIN_INTERARRIVAL 15
+
+/* polling server for the button-driven setpoint change, in ticks */
+#define APERIODIC_SERVER_CAPACITY 1
+#define APERIODIC_SERVER_PERIOD 10
+
+/* build with -DPID_FIXED_POINT to run the controller in Q31 (pid_fixed.h)
+* instead of soft-float
+*/
+#define PID_PERIOD PERIOD_TOF_SENSOR
+#define PID_KP (-0.0001f)
+#define PID_KI (-0.00001f)
+#define PID_KD (-0.00001f)
+#define PID_SETPOINT 200      /* mm, the button toggles it with 400 */
+#define PID_OUTPUT_MAX 0.3f   /* the output is clamped to +-PID_OUTPUT_MAX */
+
+/* build with -DPID_GAIN_SCHEDULE to take the bias and the gain scale from
+* the hover duty at the setpoint (pid_schedule.h) instead of PWM_OFFSET
+*/
+#define PWM_OFFSET 0.61
+
+/* TIM2 counts per PWM period, 2 kHz at the 8 MHz HSI (main.c) */
+#define PWM_PERIOD 4000
+
+typedef struct {
+    struct VL53L0X sensor;
+#ifdef PID_FIXED_POINT
+    PIDController_fixed pidController;
+#else
+    PIDController pidController;
+#endif
+    /* sensor -> PID samples, lock-free (miros_channel.h) */
+    channel_t channel_current_distance;
+    pwm_dither fanPwm;
+    int currentDistance;
+    OSThread *sensorThread; /* runs read_distance_sensor for this loop */
+    OSThread *pidThread;    /* runs calc_PID for this loop */
+#ifdef MIROS_TRACE
+    /* OS_port_cycles() of the PID call of calc_PID, PID_action() and its
+    * conversion to Q31 or PID_fixed_action(): the min is the cost of the
+    * call, the max adds the interrupts that hit it
+    */
+    OS_trace_stat pidCycles;
+#endif
+} fan_loop;
+
+extern fan_loop loops[LOOP_COUNT];
+extern mutex_t mutex_setpoint; /* the setpoints of all loops */
+/* set by whoever queues aperiodic_task, cleared by the job when it ends: its
+* stack must not be rebuilt while the job is queued or running
+*/
+extern uint8_t volatile aperiodic_task_armed;
+
+/* before OS_run(): the channel, the controller and the fan pattern of a
+* loop, 'ccr' as in pwm_dither_init(), and the threads that will run it
+*/
+void fan_loop_init(fan_loop *loop, OSThread *sensorThread, OSThread *pidThread,
+                   uint16_t *ccr, uint32_t stride);
+
+void read_distance_sensor(void);
+void calc_PID(void);
+void aperiodic_task(void);
+
+#endif /* FAN_LOOP_H */
@@ -0,0 +1,61 @@
+/****************************************************************************
+* Interrupt-driven I2C1 master with DMA (STM32F103)
+*
+* A job is an array of transfers that go out back to back, each one a
+* complete START - address - data - STOP sequence like i2c_read/i2c_write
+* in stm32.c. Jobs submitted while the bus is busy are queued in FIFO
+* order. The data bytes are moved by DMA1 channel 6 (TX) and channel 7
+* (RX); the CPU only takes the START/address events and one interrupt at
+* the end of each transfer, and the task waiting for the job is blocked
+* on a kernel event meanwhile (miros_event.h), so lower-priority tasks
+* run while the bytes move.
+*
+* i2c_dma_init() takes over I2C1 after it was set up by i2c_init(), so
+* the blocking i2c_read/i2c_write must not be used after it.
+****************************************************************************/
+#ifndef I2C_DMA_H
+#define I2C_DMA_H
+
+#include <stdint.h>
+#include "miros.h"
+
+typedef enum {
+    I2C_WRITE = 0,
+    I2C_READ = 1
+} i2c_dir;
+
+typedef enum {
+    I2C_JOB_PENDING = 0, /* queued or on the bus */
+    I2C_JOB_DONE,
+    I2C_JOB_ERROR        /* NACK, bus error or arbitration lost */
+} i2c_status;
+
+typedef struct {
+    uint8_t address; /* 7-bit slave address */
+    uint8_t dir;     /* i2c_dir */
+    uint16_t size;   /* bytes, at least 1 */
+    uint8_t *data;
+} i2c_xfer;
+
+typedef struct i2c_job {
+    i2c_xfer const *xfers;
+    uint8_t count;
+    i2c_status volatile status;
+    semaphore_t done;           /* signalled when the job completes */
+    struct i2c_job *next;       /* queue link, private */
+} i2c_job;
+
+void i2c_dma_init(void);
+
+/* queue a job, the job and its buffers must stay valid until it is done;
+* the calling task can't be aborted on a deadline miss (miros_deadline.h)
+* until it called i2c_wait on the job
+*/
+void i2c_submit(i2c_job *job);
+
+/* block the calling periodic task until the job is done, from the task
+* that submitted it
+*/
+i2c_status i2c_wait(i2c_job *job);
+
+#endif /* I2C_DMA_H */
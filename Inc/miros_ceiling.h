@@ -0,0 +1,44 @@
+/****************************************************************************
+* MiROS priority ceiling mutex
+*
+* sem_down() runs the holder of a semaphore in the NPP slot, above every
+* task, so a task is blocked by the critical regions of tasks it shares
+* nothing with. A mutex_t instead gets the ceiling of the tasks declared
+* with mutex_use(), the highest of their priorities, computed by OS_run()
+* once the priorities are final. While a task holds it, the ready tasks
+* at or below the ceiling do not preempt the holder, the ones above it
+* still do:
+*   - RM : Immediate Priority Ceiling, the holder runs at the ceiling
+*   - EDF: Stack Resource Policy, the preemption level of a task is its
+*          priority (the order of the relative deadlines); a task above
+*          the ceiling preempts the holder if its deadline is earlier
+* A task is then blocked at most once per job, by one critical region of
+* a lower task that uses one of its mutexes. The holder gives up the CPU
+* only if it blocks or calls OS_delay() in the region.
+* Aperiodic jobs have no priority of their own: they may lock a mutex
+* without declaring it and hold it in the NPP slot, as with sem_down().
+****************************************************************************/
+#ifndef MIROS_CEILING_H
+#define MIROS_CEILING_H
+
+#include <stdint.h>
+#include "miros.h"
+
+typedef struct mutex_s {
+    semaphore_t sem;
+    uint32_t users;       /* declared users, bit i for the i-th task started */
+    uint8_t ceiling;      /* highest priority of the users, set by OS_run */
+    struct mutex_s *next; /* mutexes with users, for OS_run */
+} mutex_t;
+
+void mutex_init(mutex_t *m);
+
+/* declare a periodic or sporadic task that locks the mutex,
+* after the task was started and before OS_run()
+*/
+void mutex_use(mutex_t *m, OSThread *user);
+
+void mutex_lock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+
+#endif /* MIROS_CEILING_H */
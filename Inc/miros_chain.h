@@ -0,0 +1,49 @@
+/****************************************************************************
+* MiROS task chains
+*
+* A chain is a list of tasks that process the same data one after the
+* other, as sensor -> PID -> PWM. The head is a periodic or a sporadic
+* task with its own releases. Every other task of the chain is a sporadic
+* task linked with OS_chain_link(). The kernel releases it when its
+* predecessor completes a job with OS_wait_next_period(), so it can't run
+* before the data it needs was produced and doesn't wait for a release of
+* its own. The arrival follows the rules of miros_sporadic.h. It is
+* deferred if it comes sooner than period_absolute after the last one, and
+* dropped (counted as skipped) while the previous job is still in progress.
+*
+* The kernel measures the end-to-end latency of every chain instance, from
+* the release of the head job to the completion of the tail job:
+*   - in ticks, always, rounded up as the lateness of miros_deadline.h
+*   - in port clock counts with MIROS_TRACE (see miros_trace.h)
+****************************************************************************/
+#ifndef MIROS_CHAIN_H
+#define MIROS_CHAIN_H
+
+#include <stdint.h>
+#include "miros.h"
+#include "miros_trace.h"
+
+typedef struct {
+    uint32_t count;        /* chain instances completed by the tail */
+    uint32_t latency_min;  /* head release to tail completion, ticks */
+    uint32_t latency_max;
+    uint32_t latency_last;
+} OS_chain_stats;
+
+/* release a job of the sporadic task 'succ' at every job completion of
+* 'pred', after both were started and before OS_run(). A task has at most
+* one predecessor and one successor.
+*/
+void OS_chain_link(OSThread *pred, OSThread *succ);
+
+/* latency of the chain that ends at 'tail', (OS_chain_stats *)0 if
+* 'tail' is not the last task of a chain
+*/
+OS_chain_stats const *OS_chain_stats_get(OSThread const *tail);
+
+#ifdef MIROS_TRACE
+/* the same latency in port clock counts */
+OS_trace_stat const *OS_chain_trace_get(OSThread const *tail);
+#endif
+
+#endif /* MIROS_CHAIN_H */
@@ -0,0 +1,44 @@
+/****************************************************************************
+* MiROS lock-free channel
+*
+* Passes the latest sample from one writer to one reader (a task or an
+* ISR) without a mutex: neither side blocks, disables interrupts or
+* changes its priority. The channel is a triple buffer. The writer fills
+* a slot that is neither the last published one nor the one the reader
+* holds and then publishes it with a single store; the reader claims the
+* last published slot and copies it. Either side may preempt the other at
+* any point and every read returns a whole message, never a mix of two
+* writes. A read costs at most one retry per write that preempts it.
+*
+* Only the latest message is kept: a message the reader did not read
+* before the next write is lost. channel_read() returns the number of the
+* message (1 for the first write) so the reader can tell a new sample from
+* one it has already seen.
+****************************************************************************/
+#ifndef MIROS_CHANNEL_H
+#define MIROS_CHANNEL_H
+
+#include <stdint.h>
+
+#define OS_CHANNEL_MAX_SIZE 8U /* bytes, a sample: int, float, q31_t, ... */
+
+typedef struct {
+    uint8_t data[3][OS_CHANNEL_MAX_SIZE];
+    uint32_t number[3];          /* message in each slot, 0 if none */
+    uint32_t written;            /* messages written, writer only */
+    volatile uint8_t published;  /* slot of the last message */
+    volatile uint8_t reading;    /* slot claimed by the reader */
+    uint8_t size;
+} channel_t;
+
+void channel_init(channel_t *ch, uint8_t size);
+
+/* copy size bytes from msg into the channel, single writer */
+void channel_write(channel_t *ch, void const *msg);
+
+/* copy the last message into msg, single reader; returns its number,
+* 0 (and msg unchanged) if nothing was written yet
+*/
+uint32_t channel_read(channel_t *ch, void *msg);
+
+#endif /* MIROS_CHANNEL_H */
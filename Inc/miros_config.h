@@ -0,0 +1,25 @@
+/****************************************************************************
+* MiROS limits
+*
+* The sizes of the tables of the kernel, shared by miros.c and the host
+* programs that look into them (Host/bench_region.c, Host/bench_tick.c):
+*   - NUM_MAX_PERIODIC_TASKS          : periodic and sporadic tasks, at most
+*                                       30 (one bit each in the ready set,
+*                                       plus the NPP slot), -D to change it
+*   - NUM_MAX_APERIODIC_TASKS         : slots of the aperiodic job queue
+*   - NUM_MAX_NESTED_CRITICAL_REGIONS : critical regions a task may nest
+*   - PRIORITY_CRITICAL_REGION_NPP    : priority and index in OS_tasks of
+*                                       the NPP slot, above every task
+****************************************************************************/
+#ifndef MIROS_CONFIG_H
+#define MIROS_CONFIG_H
+
+#ifndef NUM_MAX_PERIODIC_TASKS
+#define NUM_MAX_PERIODIC_TASKS 10
+#endif
+#define NUM_MAX_APERIODIC_TASKS 10
+#define NUM_MAX_NESTED_CRITICAL_REGIONS 10
+
+#define PRIORITY_CRITICAL_REGION_NPP (NUM_MAX_PERIODIC_TASKS + 1)
+
+#endif /* MIROS_CONFIG_H */
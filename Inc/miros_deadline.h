@@ -0,0 +1,59 @@
+/****************************************************************************
+* MiROS deadline monitoring
+*
+* Every periodic job has an absolute deadline, its release tick plus
+* deadline_absolute (which must not exceed period_absolute). A task that
+* has not called OS_wait_next_period() when the deadline tick is processed
+* missed it; the kernel counts the miss and then applies the policy set for
+* the task:
+*   - OS_DEADLINE_SKIP     : (default) the late job runs on, the releases
+*                            that happen before it completes are dropped
+*   - OS_DEADLINE_ABORT    : the late job is abandoned and the task starts
+*                            again from its entry at a later release; a job
+*                            inside a critical region or an abort hold is
+*                            never aborted and is handled as
+*                            OS_DEADLINE_SKIP
+*   - OS_DEADLINE_CALLBACK : the handler is called from OS_tick (interrupt
+*                            context), then as OS_DEADLINE_SKIP
+*
+* An abort hold covers the code between starting a transfer that writes
+* into the stack of the task (a DMA read into a local buffer) and its end:
+* a restart would rebuild the stack under the transfer.
+****************************************************************************/
+#ifndef MIROS_DEADLINE_H
+#define MIROS_DEADLINE_H
+
+#include <stdint.h>
+#include "miros.h"
+
+typedef enum {
+    OS_DEADLINE_SKIP = 0,
+    OS_DEADLINE_ABORT,
+    OS_DEADLINE_CALLBACK
+} OS_deadline_policy;
+
+typedef void (*OS_deadlineHandler)(OSThread *me);
+
+typedef struct {
+    uint32_t jobs;          /* jobs completed with OS_wait_next_period() */
+    uint32_t misses;        /* jobs not completed at their deadline */
+    uint32_t skipped;       /* releases dropped while a job was late */
+    uint32_t lateness_max;  /* worst completion past the deadline, ticks rounded up */
+    uint32_t lateness_last; /* of the last late job that completed */
+} OSThread_deadline_stats;
+
+/* set the policy of a periodic task, after OSPeriodic_task_start() */
+void OS_deadline_policy_set(OSThread *me,
+    OS_deadline_policy policy,
+    OS_deadlineHandler handler);
+
+/* the running job can't be aborted until the matching release; they nest,
+* and do nothing outside a periodic task
+*/
+void OS_deadline_abort_hold(void);
+void OS_deadline_abort_release(void);
+
+/* counters of a periodic task, (OSThread_deadline_stats *)0 if unknown */
+OSThread_deadline_stats const *OS_deadline_stats_get(OSThread const *me);
+
+#endif /* MIROS_DEADLINE_H */
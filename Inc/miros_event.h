@@ -0,0 +1,24 @@
+/****************************************************************************
+* MiROS event semaphores
+*
+* A semaphore initialised with semaphore_init(&ev, 0, 1) can carry an event
+* from an interrupt handler to a periodic task:
+*   - sem_pend   : takes the token or blocks the calling task until it is
+*                  handed over; unlike sem_down it does not enter a critical
+*                  region, so the task keeps its priority and no sem_up
+*                  follows
+*   - sem_signal : hands the token to the highest-priority task pending on
+*                  the semaphore (or keeps it, up to max_value) and switches
+*                  to it if it preempts; safe to call from an interrupt
+*                  handler and from a task outside a critical region
+* Only periodic tasks can block in sem_pend.
+****************************************************************************/
+#ifndef MIROS_EVENT_H
+#define MIROS_EVENT_H
+
+#include "miros.h"
+
+void sem_signal(semaphore_t *p_semaphore);
+void sem_pend(semaphore_t *p_semaphore);
+
+#endif /* MIROS_EVENT_H */
@@ -0,0 +1,81 @@
+/****************************************************************************
+* MiROS port interface
+*
+* The kernel (miros.c) only talks to the CPU through the functions below,
+* so the same scheduler runs on the STM32F103 (miros_port_cm3.c) and as a
+* Linux user-space process (Host/miros_port_posix.c).
+*
+* The port is selected at compile time:
+*   - default           : ARM Cortex-M3, PendSV context switch
+*   - MIROS_PORT_POSIX  : ucontext context switch, SysTick emulated either by
+*                         a SIGALRM interval timer or by OS_port_tick() calls
+*
+* MIROS_TICKLESS makes the idle thread sleep up to the next release or
+* timeout with OS_port_sleep() instead of calling OS_onIdle() every tick.
+* MIROS_TRACE adds the timestamp and the context switch hook of miros_trace.h.
+****************************************************************************/
+#ifndef MIROS_PORT_H
+#define MIROS_PORT_H
+
+#include <stdint.h>
+#include "miros.h"
+
+extern OSThread * volatile OS_curr; /* pointer to the current thread */
+extern OSThread * volatile OS_next; /* pointer to the next thread to run */
+
+#ifdef MIROS_PORT_POSIX
+
+/* PRIMASK emulation, the kernel keeps using the CMSIS names */
+void OS_port_disable_irq(void);
+void OS_port_enable_irq(void);
+#define __disable_irq() OS_port_disable_irq()
+#define __enable_irq()  OS_port_enable_irq()
+
+/* raise the SysTick "interrupt" from software (virtual time) */
+void OS_port_tick(void);
+
+/* start a SIGALRM interval timer that calls OS_port_tick() (real time) */
+void OS_port_systick_start(uint32_t ticks_per_sec);
+
+/* SysTick ISR provided by the board support code, as on the target */
+void SysTick_Handler(void);
+
+#else
+
+#include "stm32f1xx.h"
+
+#endif /* MIROS_PORT_POSIX */
+
+/* called once from OS_init() before any thread is started */
+void OS_port_init(void);
+
+/* build the initial context of a thread in the given stack storage */
+void OS_port_thread_init(OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize);
+
+/* request a switch from OS_curr to OS_next,
+* performed as soon as interrupts are enabled again
+*/
+void OS_port_context_switch(void);
+
+#ifdef MIROS_TRACE
+/* free-running 32-bit timestamp: DWT CYCCNT on the target, ns on the host */
+uint32_t OS_port_cycles(void);
+
+/* kernel hook, called by the port at every context switch from OS_curr to
+* OS_next, interrupts disabled
+*/
+void OS_trace_switch(void);
+#endif
+
+#ifdef MIROS_TICKLESS
+/* sleep with interrupts disabled until the tick that is 'ticks' ahead or
+* until an earlier interrupt, the tick interrupt being stopped meanwhile.
+* Returns the ticks that passed without a tick interrupt; the tick that
+* ends the sleep is still delivered to SysTick_Handler.
+*/
+uint32_t OS_port_sleep(uint32_t ticks);
+#endif
+
+#endif /* MIROS_PORT_H */
@@ -0,0 +1,63 @@
+/****************************************************************************
+* MiROS aperiodic server
+*
+* Without a server the aperiodic jobs run in background (OS_SERVER_
+* BACKGROUND): only when no periodic task is ready, so their response time
+* has no bound under a high periodic load. A server is a periodic entity
+* with a capacity C_s and a period T_s, scheduled among the periodic tasks
+* (RM priority from T_s, or EDF with the end of the current server period
+* as deadline), which runs the aperiodic jobs for up to C_s ticks per
+* period:
+*   - OS_SERVER_POLLING    : at each period start the server serves the
+*                            queue; if the queue is empty then, or runs
+*                            empty, the rest of the capacity is lost until
+*                            the next period. Analysed as a periodic task
+*                            C_s/T_s
+*   - OS_SERVER_DEFERRABLE : the capacity is kept through the period, so
+*                            a job arriving later in the period is served
+*                            at once while capacity is left; refilled to
+*                            C_s at each period start
+* Jobs left when the capacity is exhausted still run in background.
+*
+* Under EDF (-DMIROS_EDF) the server can instead be a bandwidth server of
+* utilisation U_s = C_s/T_s, which has no period of its own and runs as
+* soon as a job arrives, with a deadline that keeps its demand within U_s:
+*   - OS_SERVER_TBS : Total Bandwidth Server, job k arriving at r_k with
+*                     a declared cost C_k gets the deadline
+*                     d_k = max(r_k, d_k-1) + C_k / U_s. The cost is not
+*                     enforced: a job running past it takes the time from
+*                     the periodic tasks
+*   - OS_SERVER_CBS : Constant Bandwidth Server, the server has a budget
+*                     of C_s ticks; when it runs out, it is refilled and
+*                     the deadline moves T_s later, so an overrunning job
+*                     only delays the aperiodic jobs. The declared cost is
+*                     not used
+* A periodic task set of utilisation U_p stays schedulable while
+* U_p + U_s <= 1.
+****************************************************************************/
+#ifndef MIROS_SERVER_H
+#define MIROS_SERVER_H
+
+#include <stdint.h>
+#include "miros.h"
+
+typedef enum {
+    OS_SERVER_BACKGROUND = 0,
+    OS_SERVER_POLLING,
+    OS_SERVER_DEFERRABLE,
+    OS_SERVER_TBS,
+    OS_SERVER_CBS
+} OS_server_policy;
+
+/* start the aperiodic server, at most once and before OS_run() */
+void OS_server_start(OS_server_policy policy, uint32_t capacity, uint32_t period);
+
+/* OSAperiodic_task_start() with the declared cost of the job in ticks,
+* 0 for the server capacity
+*/
+void OSAperiodic_job_start(OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize,
+    uint32_t cost);
+
+#endif /* MIROS_SERVER_H */
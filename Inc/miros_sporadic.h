@@ -0,0 +1,36 @@
+/****************************************************************************
+* MiROS sporadic tasks
+*
+* A sporadic task takes a priority and a deadline like a periodic task,
+* but its jobs are released by an event (typically an interrupt handler)
+* with OS_sporadic_release() instead of by the tick. Its task_parameters
+* are read as:
+*   - period_absolute   : minimum inter-arrival time (T_i) in ticks; an
+*                         arrival sooner than that after the last release
+*                         is deferred until T_i has elapsed
+*   - deadline_absolute : relative deadline from the release, <= T_i
+*   - period_dinamic    : not used
+* A job ends with OS_wait_next_period(), and the deadline monitoring of
+* miros_deadline.h applies. An arrival while a job is still in progress,
+* or while a deferred release is pending, is dropped and counted as
+* skipped.
+****************************************************************************/
+#ifndef MIROS_SPORADIC_H
+#define MIROS_SPORADIC_H
+
+#include <stdint.h>
+#include "miros.h"
+
+/* same as OSPeriodic_task_start(), before OS_run() */
+void OSSporadic_task_start(
+    OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize);
+
+/* release a job of a sporadic task, also from an interrupt handler;
+* the task must be started; arrivals before OS_run() release the first
+* job when OS_run() starts the task
+*/
+void OS_sporadic_release(OSThread *me);
+
+#endif /* MIROS_SPORADIC_H */
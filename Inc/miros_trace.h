@@ -0,0 +1,40 @@
+/****************************************************************************
+* MiROS execution tracing (build with MIROS_TRACE)
+*
+* The kernel timestamps every periodic job with the port clock: DWT CYCCNT
+* on the Cortex-M3 (CPU cycles), CLOCK_MONOTONIC on the host port (ns).
+* Per task it keeps, for the completed jobs:
+*   - exec     : time the job actually ran, preemptions excluded (C_i)
+*   - response : release to OS_wait_next_period() (R_i)
+*   - start    : release to first dispatch; max - min is the release jitter
+* The timestamps are 32-bit and only their differences are used, so a
+* single job must take less than 2^32 counts (536 s at the 8 MHz HSI).
+****************************************************************************/
+#ifndef MIROS_TRACE_H
+#define MIROS_TRACE_H
+
+#include <stdint.h>
+#include "miros.h"
+
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t count;
+    uint64_t sum; /* mean = sum / count */
+} OS_trace_stat;
+
+typedef struct {
+    OS_trace_stat exec;
+    OS_trace_stat response;
+    OS_trace_stat start;
+} OSThread_trace_stats;
+
+/* statistics of a periodic task, (OSThread_trace_stats *)0 if unknown */
+OSThread_trace_stats const *OS_trace_stats_get(OSThread const *me);
+
+/* add a sample to a statistic, also for the measurements of the
+* application (OS_port_cycles() differences); a zeroed stat is empty
+*/
+void OS_trace_sample(OS_trace_stat *stat, uint32_t value);
+
+#endif /* MIROS_TRACE_H */
@@ -0,0 +1,26 @@
+/****************************************************************************
+* Floating-point PID controller of the fan
+*
+*   u = Kp*e + Ki*T*sum(e) + Kd/T*(e - e_prev), clamped to [min, max]
+* with T = PERIOD_TOF_SENSOR. The STM32F103 has no FPU, every operation
+* goes through the soft-float library; pid_fixed.h is the same law in Q31.
+* Src/pid.c is the file of the board, the host programs (Host/sim_plant.c,
+* Host/bench_pid.c) build it with the host qassert.h.
+****************************************************************************/
+#ifndef PID_H
+#define PID_H
+
+extern float PERIOD_TOF_SENSOR; /* s, T of the integral and derivative terms */
+
+typedef struct {
+    float Kp, Ki, Kd;
+    float setpoint, input;
+    float integral_sum, error_prev;
+    float max, min;
+} PIDController;
+
+void PID_setup(PIDController *controller, float kp, float ki, float kd,
+               float setpoint, float max, float min);
+float PID_action(PIDController *controller, float error);
+
+#endif /* PID_H */
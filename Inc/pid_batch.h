@@ -0,0 +1,50 @@
+/****************************************************************************
+* Batched PID, for several control loops updated together
+*
+* The control law of PID_action() (pid.h), with the state of the loops in
+* a structure of arrays: one contiguous array per gain and per state
+* variable, indexed by loop. A single PID_batch_action() call updates
+* every loop in one loop without calls, asserts, branches or pointer
+* chasing. Every step is a float multiply, add, divide, min or max, which
+* the compiler unrolls on the Cortex-M3 and vectorises on the host from
+* the SSE2 baseline of x86-64 (-O3), four loops per instruction, or eight
+* with -mavx2.
+*
+* The operations are the ones of PID_action(), in the same order, so the
+* outputs are bit-exact with one PID_action() call per loop built with
+* the same flags.
+*
+* PID_BATCH_MAX is the capacity, 4 by default (one loop per tube of a
+* rig), and can be raised with -DPID_BATCH_MAX=n.
+****************************************************************************/
+#ifndef PID_BATCH_H
+#define PID_BATCH_H
+
+#include <stdint.h>
+#include "pid.h"
+
+#ifndef PID_BATCH_MAX
+#define PID_BATCH_MAX 4U
+#endif
+
+typedef struct {
+    float Kp[PID_BATCH_MAX];
+    float Ki[PID_BATCH_MAX];
+    float Kd[PID_BATCH_MAX];
+    float integral_sum[PID_BATCH_MAX];
+    float error_prev[PID_BATCH_MAX];
+    float max[PID_BATCH_MAX];
+    float min[PID_BATCH_MAX];
+    float period; /* T of every loop, PERIOD_TOF_SENSOR for PID_action() */
+    uint32_t count;
+} PIDBatch;
+
+void PID_batch_init(PIDBatch *batch, float period);
+
+/* append a loop set up with PID_setup(), returns its index */
+uint32_t PID_batch_add(PIDBatch *batch, PIDController const *controller);
+
+/* output[i] of loop i for error[i], for the batch->count loops */
+void PID_batch_action(PIDBatch *batch, float const *error, float *output);
+
+#endif /* PID_BATCH_H */
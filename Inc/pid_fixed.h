@@ -0,0 +1,49 @@
+/****************************************************************************
+* Fixed-point PID controller, for a core without FPU
+*
+* Same control law as PID_action() in pid.c:
+*   u = Kp*e + Ki*T*sum(e) + Kd/T*(e - e_prev), clamped to [min, max]
+* with the input in integer units (mm from the VL53L0X) and the output
+* in Q31 (1.0 = 0x7FFFFFFF). The floating-point work is done once in
+* PID_fixed_setup(): Kp, Ki*T and Kd/T are turned into Q31 mantissas
+* with a common shift, so PID_fixed_action() only does 32x32->64 bit
+* multiplies and saturating adds. The coefficients must be below 1.0 in
+* magnitude (output units per input unit), max and min are saturated to
+* the Q31 range.
+****************************************************************************/
+#ifndef PID_FIXED_H
+#define PID_FIXED_H
+
+#include <stdint.h>
+
+typedef int32_t q31_t;
+
+#define Q31_MAX ((q31_t)0x7FFFFFFF)
+#define Q31_MIN ((q31_t)0x80000000)
+
+/* float constant to Q31, for initialisers; x must be in [-1, 1). A double
+* expression, folded by the compiler; at run time use PID_fixed_from_float()
+*/
+#define Q31(x) ((q31_t)((x) * 2147483648.0))
+
+typedef struct {
+    q31_t kp;           /* Kp   * 2^(31 + shift) */
+    q31_t ki_t;         /* Ki*T * 2^(31 + shift) */
+    q31_t kd_t;         /* Kd/T * 2^(31 + shift) */
+    uint8_t shift;
+    int32_t setpoint;
+    int32_t input;
+    int32_t error_sum;  /* saturating sum of the errors, the integral is T*error_sum */
+    int32_t error_prev;
+    q31_t max;
+    q31_t min;
+} PIDController_fixed;
+
+void PID_fixed_setup(PIDController_fixed *controller, float kp, float ki, float kd,
+                     float period, int32_t setpoint, float max, float min);
+q31_t PID_fixed_action(PIDController_fixed *controller, int32_t error);
+
+/* float to Q31 at run time, saturated to the Q31 range */
+q31_t PID_fixed_from_float(float x);
+
+#endif /* PID_FIXED_H */
@@ -0,0 +1,51 @@
+/****************************************************************************
+* Gain scheduling of the fan PID on the height set for the ball
+*
+* The air speed in the tube drops with the height, so the duty that holds
+* the ball (the hover duty) grows towards the top and a change of duty
+* moves the ball less there. Near the hover duty the force on the ball
+* goes with duty^2 and its slope is 2 m g / hover(h), so the plant gain
+* is 1 / hover(h) up to a constant. PID_schedule_apply() turns the PID
+* output u, tuned around a reference hover duty (PWM_OFFSET), into
+*
+*   duty = bias(d) + scale(d) * u,  bias = hover(d), scale = hover(d) / reference
+*
+* which is PWM_OFFSET + u when hover(d) is flat. The bias is the
+* feedforward that holds the ball at d, so the integral no longer has to
+* build it up, and scaling the output scales Kp, Ki and Kd together.
+*
+* d is the setpoint distance, not the measured one: the air speed that
+* drops with the height pushes the ball back towards the height where
+* the duty hovers it, and a bias that follows the measured height (after
+* the lag of the fan) cancels that restoring force: in Host/sim_plant.c
+* with -DSIM_AIR_LOSS=0.1 the mean settling time goes from 2.3 s up to
+* 5.3 s.
+*
+* bias and scale are tables of PID_SCHEDULE_POINTS breakpoints every
+* 2^PID_SCHEDULE_STEP_BITS mm from 0, linearly interpolated without
+* branches; distances past the last breakpoint take the last segment.
+* The tables are generated by Host/gen_schedule.c from hover duties
+* measured on the rig (Host/schedules/fan_hover.txt) into
+* Src/pid_schedule_table.c, which is not edited by hand. Until the rig is
+* measured fan_hover.txt is flat at PWM_OFFSET and the tables are the
+* identity, so -DPID_GAIN_SCHEDULE gives the duty of the fixed gains.
+****************************************************************************/
+#ifndef PID_SCHEDULE_H
+#define PID_SCHEDULE_H
+
+#include <stdint.h>
+#include "pid_fixed.h"
+
+#define PID_SCHEDULE_STEP_BITS 6U /* 64 mm between breakpoints */
+#define PID_SCHEDULE_POINTS 11U   /* 0 ... 640 mm */
+
+/* the scale in Q30, 1.0 = 2^30 */
+#define PID_SCHEDULE_ONE ((q31_t)1 << 30)
+
+extern q31_t const pid_schedule_bias[PID_SCHEDULE_POINTS];  /* Q31 duty */
+extern q31_t const pid_schedule_scale[PID_SCHEDULE_POINTS]; /* Q30 */
+
+/* the duty for the PID output 'output' at the setpoint 'distance' mm, in [0, 1) */
+q31_t PID_schedule_apply(int32_t distance, q31_t output);
+
+#endif /* PID_SCHEDULE_H */
@@ -0,0 +1,45 @@
+/****************************************************************************
+* PWM duty with first-order sigma-delta dithering
+*
+* A timer with period ARR+1 counts can only output the duties k/(ARR+1).
+* The duty in Q31 is turned into a compare value with an integer part
+* and a 32-bit fraction of a count, and the fraction is spread over
+* PWM_DITHER_PERIODS consecutive PWM periods by a first-order sigma-delta
+* modulator: every period gets the integer part, plus one count when the
+* accumulated fraction overflows. The residue of the accumulator carries
+* over to the next pattern.
+*
+* The pattern is a circular buffer that a DMA channel copies into CCR1,
+* one value per update event (TIM2_UP, DMA1 channel 2, see MX_TIM2_Init
+* in main.c), so the CPU only writes it when the duty changes. The buffer
+* belongs to the caller and the values of one channel are 'stride' apart,
+* so that the patterns of several channels can be interleaved for a DMA
+* burst to CCR1...CCRn (one uint16_t per channel and update event). The mean
+* over any PWM_DITHER_PERIODS consecutive periods is the requested duty
+* within 1/PWM_DITHER_PERIODS of a count, which adds log2(PWM_DITHER_PERIODS)
+* bits to the resolution of the timer as long as the fan averages over
+* that many periods. Host/bench_dither.c measures the effective bits for
+* several prescaler/period pairs.
+****************************************************************************/
+#ifndef PWM_DITHER_H
+#define PWM_DITHER_H
+
+#include <stdint.h>
+#include "pid_fixed.h"
+
+#define PWM_DITHER_PERIODS 32U
+
+typedef struct {
+    uint16_t *ccr;    /* read by the DMA, ccr[i * stride] for period i */
+    uint32_t stride;
+    uint32_t counts;  /* ARR + 1 */
+    uint32_t residue; /* accumulated fraction of a count */
+} pwm_dither;
+
+/* 'ccr' holds PWM_DITHER_PERIODS values, 'stride' apart */
+void pwm_dither_init(pwm_dither *pwm, uint16_t *ccr, uint32_t stride, uint32_t arr);
+
+/* write the pattern for 'duty', clamped to [0, 1] */
+void pwm_dither_set(pwm_dither *pwm, q31_t duty);
+
+#endif /* PWM_DITHER_H */
@@ -0,0 +1,34 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "VL53L0X.h"
+#include "VL53L0X_dma.h"
+#include "i2c_dma.h"
+
+uint16_t VL53L0X_readRangeContinuousMillimetersDMA(struct VL53L0X *dev) {
+    static uint8_t range_reg = RESULT_RANGE_STATUS + 10;
+    static uint8_t interrupt_clear[2] = { SYSTEM_INTERRUPT_CLEAR, 0x01 };
+    uint8_t const address = VL53L0X_I2C_ADDRESS_OF(dev);
+    uint8_t buf[2];
+    i2c_xfer const xfers[] = {
+        { address, I2C_WRITE, 1U, &range_reg },
+        { address, I2C_READ,  2U, buf },
+        { address, I2C_WRITE, 2U, interrupt_clear },
+    };
+    i2c_job job = { .xfers = xfers, .count = 3U };
+
+    i2c_submit(&job);
+    if (i2c_wait(&job) != I2C_JOB_DONE) {
+        dev->did_timeout = true;
+        return 65535;
+    }
+
+    // assumptions: Linearity Corrective Gain is 1000 (default);
+    // fractional ranging is not enabled
+    return (uint16_t) ((buf[0] << 8) | buf[1]);
+}
+
+void VL53L0X_assign_address(struct VL53L0X *dev, uint8_t address) {
+    // VL53L0X_writeReg talks to the reset address, where the sensor still is
+    VL53L0X_writeReg(dev, I2C_SLAVE_DEVICE_ADDRESS, (uint8_t) (address >> 1));
+    dev->address = address;
+}
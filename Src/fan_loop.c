@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "miros_server.h"
+#include "fan_loop.h"
+#include "pid_schedule.h"
+
+fan_loop loops[LOOP_COUNT];
+mutex_t mutex_setpoint;
+uint8_t volatile aperiodic_task_armed = 0U;
+
+void fan_loop_init(fan_loop *loop, OSThread *sensorThread, OSThread *pidThread,
+                   uint16_t *ccr, uint32_t stride) {
+
+    loop->sensorThread = sensorThread;
+    loop->pidThread = pidThread;
+    channel_init(&loop->channel_current_distance, sizeof(loop->currentDistance));
+#ifdef PID_FIXED_POINT
+    PID_fixed_setup(&loop->pidController, PID_KP, PID_KI, PID_KD, PID_PERIOD,
+                    PID_SETPOINT, PID_OUTPUT_MAX, -PID_OUTPUT_MAX);
+#else
+    PID_setup(&loop->pidController, PID_KP, PID_KI, PID_KD,
+              PID_SETPOINT, PID_OUTPUT_MAX, -PID_OUTPUT_MAX);
+#endif
+    pwm_dither_init(&loop->fanPwm, ccr, stride, PWM_PERIOD - 1);
+}
+
+// The loop whose sensor or PID task is running
+static fan_loop *loop_of_curr(void) {
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        if ((loops[i].sensorThread == OS_curr) || (loops[i].pidThread == OS_curr)) {
+            return &loops[i];
+        }
+    }
+    OS_error();
+    return &loops[0];
+}
+
+void read_distance_sensor(void){
+    fan_loop *loop = loop_of_curr();
+
+    while(1){
+        loop->currentDistance = (int) VL53L0X_readRangeContinuousMillimetersDMA(&loop->sensor);
+        channel_write(&loop->channel_current_distance, &loop->currentDistance);
+
+        OS_wait_next_period();
+    }
+}
+
+void calc_PID(void){
+    fan_loop *loop = loop_of_curr();
+
+    while(1){
+        int distance;
+
+        if (channel_read(&loop->channel_current_distance, &distance) != 0U) {
+            loop->pidController.input = distance;
+        }
+
+        mutex_lock(&mutex_setpoint);
+
+#ifdef PID_FIXED_POINT
+        int32_t error = loop->pidController.setpoint - loop->pidController.input;
+#else
+        float error = loop->pidController.setpoint - loop->pidController.input;
+#endif
+#ifdef PID_GAIN_SCHEDULE
+        int32_t setpoint = (int32_t) loop->pidController.setpoint;
+#endif
+
+        mutex_unlock(&mutex_setpoint);
+
+#ifdef MIROS_TRACE
+        uint32_t pid_start = OS_port_cycles();
+#endif
+#ifdef PID_FIXED_POINT
+        q31_t pid_pwm_value = PID_fixed_action(&loop->pidController, error);
+#else
+        q31_t pid_pwm_value = PID_fixed_from_float(PID_action(&loop->pidController, error));
+#endif
+#ifdef MIROS_TRACE
+        OS_trace_sample(&loop->pidCycles, OS_port_cycles() - pid_start);
+#endif
+
+#ifdef PID_GAIN_SCHEDULE
+        q31_t pwm_value = PID_schedule_apply(setpoint, pid_pwm_value);
+#else
+        // The output is clamped to +-0.3, the sum stays below 1.0
+        q31_t pwm_value = pid_pwm_value + Q31(PWM_OFFSET);
+#endif
+
+        // The DMA applies the pattern from the next update event on, at
+        // the start of a PWM cycle
+        pwm_dither_set(&loop->fanPwm, pwm_value);
+
+        OS_wait_next_period();
+    }
+}
+
+void aperiodic_task(void){
+
+    mutex_lock(&mutex_setpoint);
+
+    // The button steps every loop
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        if (loops[i].pidController.setpoint == 400)
+            loops[i].pidController.setpoint = 200;
+        else
+            loops[i].pidController.setpoint = 400;
+    }
+
+    mutex_unlock(&mutex_setpoint);
+
+    // Masked up to the end of the job, so the button can only queue it
+    // again once it left the queue
+    __disable_irq();
+    aperiodic_task_armed = 0U;
+    OS_finished_aperiodic_task();
+}
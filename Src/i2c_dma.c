@@ -0,0 +1,211 @@
+/****************************************************************************
+* Interrupt-driven I2C1 master with DMA (STM32F103), see i2c_dma.h
+*
+* Per transfer:
+*   SB    (I2C1_EV) : send the address byte
+*   ADDR  (I2C1_EV) : arm the DMA channel and set DMAEN, then clear ADDR.
+*                     For a read of 2 or more bytes LAST makes the
+*                     peripheral NACK the last byte by itself; a 1-byte
+*                     read cannot use DMA (RM0008 26.3.3) and takes the
+*                     byte on RXNE instead
+*   write end       : BTF with the TX channel empty (I2C1_EV), then STOP
+*   read end        : transfer complete of the RX channel, then STOP
+* Errors (I2C1_ER, DMA transfer error) end the job with I2C_JOB_ERROR.
+****************************************************************************/
+#include <stdint.h>
+#include "miros.h"
+#include "miros_event.h"
+#include "miros_deadline.h"
+#include "qassert.h"
+#include "i2c_dma.h"
+#include "stm32f1xx_hal.h"
+
+Q_DEFINE_THIS_FILE
+
+#define I2C_DMA_TX DMA1_Channel6
+#define I2C_DMA_RX DMA1_Channel7
+
+#define I2C_SR1_ERRORS (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR | I2C_SR1_TIMEOUT)
+
+static i2c_job *i2c_head; /* job on the bus */
+static i2c_job *i2c_tail;
+static uint8_t i2c_index; /* transfer of i2c_head on the bus */
+
+static void i2c_dma_arm(DMA_Channel_TypeDef *ch, uint8_t *data, uint16_t size, uint32_t ccr) {
+    ch->CCR = 0U;
+    ch->CPAR = (uint32_t) &I2C1->DR;
+    ch->CMAR = (uint32_t) data;
+    ch->CNDTR = size;
+    ch->CCR = ccr | DMA_CCR_MINC | DMA_CCR_TEIE | DMA_CCR_EN;
+}
+
+static void i2c_start(void) {
+    i2c_xfer const *x = &i2c_head->xfers[i2c_index];
+
+    /* the STOP of the previous transfer takes one SCL period at most */
+    while (I2C1->CR1 & I2C_CR1_STOP) {
+    }
+
+    I2C1->CR1 &= ~I2C_CR1_POS;
+    if (x->dir == I2C_READ) {
+        I2C1->CR1 |= I2C_CR1_ACK;
+    }
+    I2C1->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    I2C1->CR1 |= I2C_CR1_START;
+}
+
+/* end the job on the bus and start the next one, in interrupt context */
+static void i2c_finish(i2c_status status) {
+    i2c_job *job = i2c_head;
+
+    I2C_DMA_TX->CCR = 0U;
+    I2C_DMA_RX->CCR = 0U;
+    I2C1->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITERREN | I2C_CR2_ITBUFEN
+                   | I2C_CR2_DMAEN | I2C_CR2_LAST);
+
+    i2c_head = job->next;
+    if (i2c_head == (i2c_job *) 0) {
+        i2c_tail = (i2c_job *) 0;
+    }
+    job->status = status;
+    sem_signal(&job->done);
+
+    if (i2c_head != (i2c_job *) 0) {
+        i2c_index = 0U;
+        i2c_start();
+    }
+}
+
+/* the current transfer is complete, STOP has been requested */
+static void i2c_next(void) {
+    I2C_DMA_TX->CCR = 0U;
+    I2C_DMA_RX->CCR = 0U;
+    I2C1->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+
+    if (++i2c_index < i2c_head->count) {
+        i2c_start();
+    } else {
+        i2c_finish(I2C_JOB_DONE);
+    }
+}
+
+void i2c_dma_init(void) {
+    __disable_irq();
+
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    I2C_DMA_TX->CCR = 0U;
+    I2C_DMA_RX->CCR = 0U;
+    i2c_head = (i2c_job *) 0;
+    i2c_tail = (i2c_job *) 0;
+
+    NVIC_EnableIRQ(I2C1_EV_IRQn);
+    NVIC_EnableIRQ(I2C1_ER_IRQn);
+    NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+    NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+    __enable_irq();
+}
+
+void i2c_submit(i2c_job *job) {
+    Q_REQUIRE((job != (i2c_job *) 0) && (job->count != 0U));
+
+    job->status = I2C_JOB_PENDING;
+    job->next = (i2c_job *) 0;
+    semaphore_init(&job->done, 0, 1);
+
+    /* the job and its buffers may be on the stack of the task, which an
+    * OS_DEADLINE_ABORT restart must not rebuild until i2c_wait returns
+    */
+    OS_deadline_abort_hold();
+
+    __disable_irq();
+    if (i2c_tail == (i2c_job *) 0) {
+        i2c_head = job;
+        i2c_tail = job;
+        i2c_index = 0U;
+        i2c_start();
+    } else {
+        i2c_tail->next = job;
+        i2c_tail = job;
+    }
+    __enable_irq();
+}
+
+i2c_status i2c_wait(i2c_job *job) {
+    sem_pend(&job->done);
+    OS_deadline_abort_release();
+    return job->status;
+}
+
+void I2C1_EV_IRQHandler(void) {
+    uint32_t sr1 = I2C1->SR1;
+    i2c_xfer const *x;
+
+    if (i2c_head == (i2c_job *) 0) {
+        return;
+    }
+    x = &i2c_head->xfers[i2c_index];
+
+    if (sr1 & I2C_SR1_SB) {
+        I2C1->DR = (uint8_t) ((x->address << 1) | x->dir);
+    } else if (sr1 & I2C_SR1_ADDR) {
+        Q_ASSERT(x->size != 0U);
+        if (x->dir == I2C_WRITE) {
+            i2c_dma_arm(I2C_DMA_TX, x->data, x->size, DMA_CCR_DIR);
+            I2C1->CR2 |= I2C_CR2_DMAEN;
+            (void) I2C1->SR2;
+        } else if (x->size == 1U) {
+            I2C1->CR1 &= ~I2C_CR1_ACK;
+            (void) I2C1->SR2;
+            I2C1->CR1 |= I2C_CR1_STOP;
+            I2C1->CR2 |= I2C_CR2_ITBUFEN;
+        } else {
+            i2c_dma_arm(I2C_DMA_RX, x->data, x->size, DMA_CCR_TCIE);
+            I2C1->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+            (void) I2C1->SR2;
+        }
+    } else if ((sr1 & I2C_SR1_RXNE) && (x->dir == I2C_READ) && (x->size == 1U)) {
+        x->data[0] = (uint8_t) I2C1->DR;
+        i2c_next();
+    } else if ((sr1 & I2C_SR1_BTF) && (x->dir == I2C_WRITE)
+               && (I2C_DMA_TX->CNDTR == 0U)) {
+        I2C1->CR1 |= I2C_CR1_STOP;
+        i2c_next();
+    }
+}
+
+void I2C1_ER_IRQHandler(void) {
+    uint32_t sr1 = I2C1->SR1;
+
+    I2C1->SR1 = sr1 & ~I2C_SR1_ERRORS;
+    if (!(sr1 & I2C_SR1_ARLO)) {
+        I2C1->CR1 |= I2C_CR1_STOP;
+    }
+    if (i2c_head != (i2c_job *) 0) {
+        i2c_finish(I2C_JOB_ERROR);
+    }
+}
+
+/* TX channel, transfer error only: the end of a write is seen on BTF */
+void DMA1_Channel6_IRQHandler(void) {
+    DMA1->IFCR = DMA_IFCR_CGIF6;
+    I2C1->CR1 |= I2C_CR1_STOP;
+    if (i2c_head != (i2c_job *) 0) {
+        i2c_finish(I2C_JOB_ERROR);
+    }
+}
+
+void DMA1_Channel7_IRQHandler(void) {
+    uint32_t isr = DMA1->ISR;
+
+    DMA1->IFCR = DMA_IFCR_CGIF7;
+    I2C1->CR1 |= I2C_CR1_STOP;
+    if (i2c_head == (i2c_job *) 0) {
+        return;
+    }
+    if (isr & DMA_ISR_TEIF7) {
+        i2c_finish(I2C_JOB_ERROR);
+    } else {
+        i2c_next();
+    }
+}
@@ -1,40 +1,65 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "miros.h"
-#include "pid.h"
+#include "miros_port.h"
+#include "miros_sporadic.h"
+#include "miros_chain.h"
+#include "miros_server.h"
+#include "miros_ceiling.h"
+#include "miros_channel.h"
+#include "fan_loop.h"
+#include "pwm_dither.h"
 #include "VL53L0X.h"
+#include "VL53L0X_dma.h"
+#include "i2c_dma.h"
 #include "config_gpio.h"
 #include "stm32f1xx_hal.h"
 
-float pwmVal = 0;
+// Control loops (fan_loop.h), each with its own tube, VL53L0X and TIM2
+// channel, on one I2C1 bus
+
+// VL53L0X data-ready lines (GPIO1): loop i on PA1 + i, EXTI1 + i
+#define DISTANCE_SENSOR_DRDY_PORT GPIOA
+
+// VL53L0X XSHUT lines, with more than one sensor: loop i on PB12 + i
+#define DISTANCE_SENSOR_XSHUT_PORT GPIOB
+
+// TIM2 at the 8 MHz HSI: 2 kHz PWM with PWM_PERIOD (4000) counts per
+// period, dithered over PWM_DITHER_PERIODS periods (Host/bench_dither.c
+// for other pairs)
+#define PWM_PRESCALER 1
+
+// Hardware of loop i
+static uint16_t const drdy_pin[4] = {GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3, GPIO_PIN_4};
+static IRQn_Type const drdy_irq[4] = {EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn};
+static uint16_t const xshut_pin[4] = {GPIO_PIN_12, GPIO_PIN_13, GPIO_PIN_14, GPIO_PIN_15};
+static uint32_t const fan_channel[4] = {TIM_CHANNEL_1, TIM_CHANNEL_2, TIM_CHANNEL_3, TIM_CHANNEL_4};
+
 uint32_t previousTick = 0;
-int currentDistance;
 
-struct_tasks struct_distance_sensor_task;
-struct_tasks struct_calc_pid;
-struct_tasks struct_pwm_actuator_task;
+// One task of each array per loop, task i runs loop i
+struct_tasks struct_distance_sensor_task[LOOP_COUNT];
+struct_tasks struct_calc_pid[LOOP_COUNT];
 struct_tasks struct_aperiodic_task;
 
+// Shared by the loops, the kernel only reads them
 OSThread_periodics_task_parameters parameters_distance_sensor_task;
 OSThread_periodics_task_parameters parameters_calc_pid;
-OSThread_periodics_task_parameters parameters_pwm_actuator_task;
 
-PIDController pidController;
-semaphore_t mutex_setpoint;
-semaphore_t mutex_current_distance;
-semaphore_t mutex_pwm_value;
+// Fan duties, fanCcr[period][loop]: DMA1 channel 2 copies one row into
+// CCR1...CCRn with a burst on every update event
+uint16_t fanCcr[PWM_DITHER_PERIODS][LOOP_COUNT];
 
 TIM_HandleTypeDef htim2;
 
-struct VL53L0X distanceSensor;
-
-static struct VL53L0X myTOFsensor = {.io_2v8 = false, .address = 0x52, .io_timeout = 500, .did_timeout = false};
-
-void read_distance_sensor();
-void calc_PID();
-void pwm_actuator();
 void distance_sensor_init();
 void MX_TIM2_Init(void);
+void pwm_dma_init(void);
+void distance_sensor_irq_init();
+void distance_sensor_xshut_init();
+void boot_clock_init(void);
+void boot_delay_ms(uint32_t ms);
+void fan_pwm_gpio_init(void);
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
 void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
 
@@ -46,115 +71,123 @@ int main() {
     MX_GPIO_Init();
     MX_TIM2_Init();
     distance_sensor_init();
+    i2c_dma_init(); /* I2C1 is interrupt driven from here on */
+
+    mutex_init(&mutex_setpoint);
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        fan_loop_init(&loops[i],
+                      &struct_distance_sensor_task[i].TCB_thread,
+                      &struct_calc_pid[i].TCB_thread,
+                      &fanCcr[0][i], LOOP_COUNT);
+    }
 
-    semaphore_init(&mutex_setpoint, 1, 1);
-    semaphore_init(&mutex_current_distance, 1, 1);
-    semaphore_init(&mutex_pwm_value, 1, 1);
-    PID_setup(&pidController, -0.0001, -0.00001, -0.00001, 200, 0.3, -0.3);
-
+    // Released by the data-ready line, one sample per 20 ms timing budget
     parameters_distance_sensor_task.deadline_absolute = 5;
     parameters_distance_sensor_task.deadline_dinamic = 5;
-    parameters_distance_sensor_task.period_absolute = 5;
-    parameters_distance_sensor_task.period_dinamic = 5;
+    parameters_distance_sensor_task.period_absolute = DISTANCE_SENSOR_MIN_INTERARRIVAL;
+    parameters_distance_sensor_task.period_dinamic = DISTANCE_SENSOR_MIN_INTERARRIVAL;
 
+    // Chained after read_distance_sensor, once per fresh sample
     parameters_calc_pid.deadline_absolute = 5;
     parameters_calc_pid.deadline_dinamic = 5;
-    parameters_calc_pid.period_absolute = 5;
-    parameters_calc_pid.period_dinamic = 5;
-
-    parameters_pwm_actuator_task.deadline_absolute = 5;
-    parameters_pwm_actuator_task.deadline_dinamic = 5;
-    parameters_pwm_actuator_task.period_absolute = 5;
-    parameters_pwm_actuator_task.period_dinamic = 5;
-
-    struct_distance_sensor_task.TCB_thread.task_parameters = &parameters_distance_sensor_task;
-    struct_calc_pid.TCB_thread.task_parameters = &parameters_calc_pid;
-    struct_pwm_actuator_task.TCB_thread.task_parameters = &parameters_pwm_actuator_task;
-
-    OSPeriodic_task_start(&struct_distance_sensor_task.TCB_thread, 
-                            &read_distance_sensor,
-                            struct_distance_sensor_task.stack_thread,
-                            sizeof(struct_distance_sensor_task.stack_thread));
-
-    OSPeriodic_task_start(&struct_calc_pid.TCB_thread, 
-                            &calc_PID,
-                            struct_calc_pid.stack_thread,
-                            sizeof(struct_calc_pid.stack_thread));
-    
-    OSPeriodic_task_start(&struct_pwm_actuator_task.TCB_thread, 
-                            &pwm_actuator,
-                            struct_pwm_actuator_task.stack_thread,
-                            sizeof(struct_pwm_actuator_task.stack_thread));
-
-    HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_1);
+    parameters_calc_pid.period_absolute = DISTANCE_SENSOR_MIN_INTERARRIVAL;
+    parameters_calc_pid.period_dinamic = DISTANCE_SENSOR_MIN_INTERARRIVAL;
 
-    OS_run();
-}
-
-void read_distance_sensor(){
-    while(1){
-        currentDistance = (int) VL53L0X_readRangeContinuousMillimeters(&distanceSensor);
-
-        sem_down(&mutex_current_distance);
-        pidController.input = currentDistance;
-        sem_up(&mutex_current_distance);
-
-        OS_wait_next_period();
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        struct_distance_sensor_task[i].TCB_thread.task_parameters = &parameters_distance_sensor_task;
+        struct_calc_pid[i].TCB_thread.task_parameters = &parameters_calc_pid;
     }
-}
-
-void calc_PID(){
-    while(1){
-
-        sem_down(&mutex_current_distance);
-        sem_down(&mutex_setpoint);
-
-        float error = pidController.setpoint - pidController.input;
 
-        sem_up(&mutex_setpoint);
-        sem_up(&mutex_current_distance);
-
-        float pid_pwm_value = PID_action(&pidController, error);
-
-        sem_down(&mutex_pwm_value);
-        pwmVal = pid_pwm_value + 0.61;
-        sem_up(&mutex_pwm_value);
-
-        OS_wait_next_period();
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        OSSporadic_task_start(&struct_distance_sensor_task[i].TCB_thread,
+                                &read_distance_sensor,
+                                struct_distance_sensor_task[i].stack_thread,
+                                sizeof(struct_distance_sensor_task[i].stack_thread));
     }
-}
 
-void pwm_actuator(){
-    while(1){
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        OSSporadic_task_start(&struct_calc_pid[i].TCB_thread,
+                                &calc_PID,
+                                struct_calc_pid[i].stack_thread,
+                                sizeof(struct_calc_pid[i].stack_thread));
+    }
 
-        sem_down(&mutex_pwm_value);
-        TIM2->CCR1 = (int) (pwmVal*TIM2->ARR);
-        sem_up(&mutex_pwm_value);
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        // Sensor -> PID run back to back on each sample, the kernel measures
+        // the latency from the sensor release to the pattern write
+        OS_chain_link(&struct_distance_sensor_task[i].TCB_thread, &struct_calc_pid[i].TCB_thread);
 
-        OS_wait_next_period();
+        // The ceiling of the mutex is the highest priority of these tasks,
+        // the aperiodic_task takes mutex_setpoint in the NPP slot
+        mutex_use(&mutex_setpoint, &struct_calc_pid[i].TCB_thread);
     }
-}
 
-void aperiodic_task(){
+    // Bounded response for aperiodic_task, scheduled like a periodic task
+    OS_server_start(OS_SERVER_POLLING, APERIODIC_SERVER_CAPACITY, APERIODIC_SERVER_PERIOD);
 
-    sem_down(&mutex_setpoint);
+    pwm_dma_init();
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        HAL_TIM_PWM_Start(&htim2, fan_channel[i]);
+    }
 
-    if (pidController.setpoint == 400)
-        pidController.setpoint = 200;
-    else
-        pidController.setpoint = 400;
-    
-    sem_up(&mutex_setpoint);
+    // The sensors are ranging and EXTI has latched their edges: the
+    // interrupts are taken now, with the tasks they release started, and
+    // the kernel releases the first reads when OS_run() starts them
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        HAL_NVIC_EnableIRQ(drdy_irq[i]);
+    }
 
-    OS_finished_aperiodic_task();
+    OS_run();
 }
 
+// The blocking driver of VL53L0X.c only talks to the reset address 0x52,
+// so with more than one sensor they are brought up one at a time: all
+// XSHUT lines low, then for each sensor XSHUT high, the whole setup at
+// 0x52, and a new address (0x54, 0x56, ...) for the DMA reads. Sensor i
+// starts ranging i/LOOP_COUNT of a timing budget after sensor 0, so that
+// the four reads of a budget go out 5 ms apart on I2C1 (README)
 void distance_sensor_init() {
 
-    while(!VL53L0X_init(&myTOFsensor));
-    VL53L0X_setMeasurementTimingBudget(&myTOFsensor, 20e3); // 20 ms
-    VL53L0X_startContinuous(&myTOFsensor, 0);
-    
+    uint32_t first_start = 0;
+
+    boot_clock_init();
+    distance_sensor_xshut_init();
+    distance_sensor_irq_init();
+
+    for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+        struct VL53L0X *sensor = &loops[i].sensor;
+
+        sensor->io_2v8 = false;
+        sensor->address = VL53L0X_DEFAULT_ADDRESS;
+        sensor->io_timeout = 500;
+        sensor->did_timeout = false;
+
+#if LOOP_COUNT > 1
+        HAL_GPIO_WritePin(DISTANCE_SENSOR_XSHUT_PORT, xshut_pin[i], GPIO_PIN_SET);
+        boot_delay_ms(2); // tBOOT is 1.2 ms
+#endif
+        while(!VL53L0X_init(sensor));
+        VL53L0X_setMeasurementTimingBudget(sensor, DISTANCE_SENSOR_TIMING_BUDGET * 1000);
+
+        // Phase of the samples of sensor i from sensor 0
+        if (i == 0U) {
+            first_start = DWT->CYCCNT;
+        } else {
+            while (((DWT->CYCCNT - first_start) / (SystemCoreClock / 1000U))
+                   % DISTANCE_SENSOR_TIMING_BUDGET
+                   != i * DISTANCE_SENSOR_TIMING_BUDGET / LOOP_COUNT);
+        }
+        VL53L0X_startContinuous(sensor, 0);
+
+        // GPIO1 pulls low on every new sample until SYSTEM_INTERRUPT_CLEAR,
+        // EXTI latches the edges of the sensors already running
+        VL53L0X_writeReg(sensor, SYSTEM_INTERRUPT_CLEAR, 0x01);
+
+#if LOOP_COUNT > 1
+        VL53L0X_assign_address(sensor, (uint8_t) (VL53L0X_DEFAULT_ADDRESS + 2U * (i + 1U)));
+#endif
+    }
+
     return;
 }
 
@@ -165,11 +198,11 @@ void MX_TIM2_Init(void){
   TIM_OC_InitTypeDef sConfigOC = {0};
 
   htim2.Instance = TIM2;
-  htim2.Init.Prescaler = 8-1;
+  htim2.Init.Prescaler = PWM_PRESCALER-1;
   htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
-  htim2.Init.Period = 500-1;
+  htim2.Init.Period = PWM_PERIOD-1;
   htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-  htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
   if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
   {
 	  OS_error();
@@ -189,23 +222,162 @@ void MX_TIM2_Init(void){
   {
 	  OS_error();
   }
+  // HAL_TIM_PWM_ConfigChannel also sets OC1PE: the DMA writes the CCR1
+  // preload register and the timer copies it to the active one on the
+  // update event, so the duty never changes in the middle of a cycle
   sConfigOC.OCMode = TIM_OCMODE_PWM1;
   sConfigOC.Pulse = 0;
   sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
   sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
-  if (HAL_TIM_PWM_ConfigChannel(&htim2, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+  for (uint32_t i = 0U; i < LOOP_COUNT; ++i)
   {
-	  OS_error();
+    if (HAL_TIM_PWM_ConfigChannel(&htim2, &sConfigOC, fan_channel[i]) != HAL_OK)
+    {
+	    OS_error();
+    }
   }
+#if LOOP_COUNT > 1
+  fan_pwm_gpio_init();
+#else
   HAL_TIM_MspPostInit(&htim2);
+#endif
 }
 
+// TIM2 full remap, the default CH2 pin PA1 is the data-ready line of loop
+// 0: CH1 PA15, CH2 PB3, CH3 PB10, CH4 PB11. PA15 and PB3 are JTDI and
+// JTDO, JTAG is off and the board is debugged over SWD
+void fan_pwm_gpio_init(void) {
+
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+  static GPIO_TypeDef * const port[4] = {GPIOA, GPIOB, GPIOB, GPIOB};
+  static uint16_t const pin[4] = {GPIO_PIN_15, GPIO_PIN_3, GPIO_PIN_10, GPIO_PIN_11};
+
+  __HAL_RCC_AFIO_CLK_ENABLE();
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+  __HAL_AFIO_REMAP_SWJ_NOJTAG();
+  __HAL_AFIO_REMAP_TIM2_ENABLE();
+
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+    GPIO_InitStruct.Pin = pin[i];
+    HAL_GPIO_Init(port[i], &GPIO_InitStruct);
+  }
+}
+
+// One fanCcr row per update event, circular, no interrupts
+void pwm_dma_init(void) {
+
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+  // Each TIM2_UP request is a burst of LOOP_COUNT transfers through DMAR,
+  // to CCR1, CCR2, ... (RM0008 15.4.19)
+  TIM2->DCR = TIM_DMABASE_CCR1 | ((LOOP_COUNT - 1U) << TIM_DCR_DBL_Pos);
+
+  // Memory to peripheral, 16 bits each side
+  DMA1_Channel2->CCR = 0U;
+  DMA1_Channel2->CPAR = (uint32_t) &TIM2->DMAR;
+  DMA1_Channel2->CMAR = (uint32_t) fanCcr;
+  DMA1_Channel2->CNDTR = PWM_DITHER_PERIODS * LOOP_COUNT;
+  DMA1_Channel2->CCR = DMA_CCR_DIR | DMA_CCR_CIRC | DMA_CCR_MINC
+                       | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_EN;
+
+  TIM2->DIER |= TIM_DIER_UDE;
+}
+
+// Sensors held in reset until distance_sensor_init brings them up
+void distance_sensor_xshut_init() {
+
+#if LOOP_COUNT > 1
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+
+  for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+    HAL_GPIO_WritePin(DISTANCE_SENSOR_XSHUT_PORT, xshut_pin[i], GPIO_PIN_RESET);
+    GPIO_InitStruct.Pin = xshut_pin[i];
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(DISTANCE_SENSOR_XSHUT_PORT, &GPIO_InitStruct);
+  }
+  boot_delay_ms(1);
+#endif
+}
+
+// HAL_GetTick() and HAL_Delay() only run from OS_run() on, SysTick is
+// started by OS_onStartup(), so the boot sequence counts on the DWT
+// cycle counter (also the MIROS_TRACE clock, which it leaves running)
+void boot_clock_init(void) {
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void boot_delay_ms(uint32_t ms) {
+
+  uint32_t start = DWT->CYCCNT;
+
+  while ((DWT->CYCCNT - start) < ms * (SystemCoreClock / 1000U));
+}
+
+// The interrupts are enabled by main() once every sensor is running at
+// its address and the tasks they release are started
+void distance_sensor_irq_init() {
+
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+
+  // VL53L0X GPIO1 (open drain, active low) on PA1...PA4
+  for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+    GPIO_InitStruct.Pin = drdy_pin[i];
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(DISTANCE_SENSOR_DRDY_PORT, &GPIO_InitStruct);
+
+    HAL_NVIC_SetPriority(drdy_irq[i], 1U, 1U);
+  }
+}
+
+void EXTI1_IRQHandler(void) {
+  HAL_GPIO_EXTI_IRQHandler(drdy_pin[0]);
+}
+
+#if LOOP_COUNT > 1
+void EXTI2_IRQHandler(void) {
+  HAL_GPIO_EXTI_IRQHandler(drdy_pin[1]);
+}
+#endif
+
+#if LOOP_COUNT > 2
+void EXTI3_IRQHandler(void) {
+  HAL_GPIO_EXTI_IRQHandler(drdy_pin[2]);
+}
+#endif
+
+#if LOOP_COUNT > 3
+void EXTI4_IRQHandler(void) {
+  HAL_GPIO_EXTI_IRQHandler(drdy_pin[3]);
+}
+#endif
 
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
 
 	uint32_t currentTick = HAL_GetTick();
 
-	if (GPIO_Pin == GPIO_PIN_0 && (currentTick - previousTick) > 10){
+	// A new range sample is ready
+	for (uint32_t i = 0U; i < LOOP_COUNT; ++i) {
+		if (GPIO_Pin == drdy_pin[i]){
+			OS_sporadic_release(&struct_distance_sensor_task[i].TCB_thread);
+			return;
+		}
+	}
+
+	// A press while the job is queued or running is dropped
+	if (GPIO_Pin == GPIO_PIN_0 && (currentTick - previousTick) > 10
+	    && !aperiodic_task_armed){
+		    aperiodic_task_armed = 1U;
 		    OSAperiodic_task_start(&struct_aperiodic_task.TCB_thread,
                                     &aperiodic_task,
                                     struct_aperiodic_task.stack_thread,
@@ -32,34 +32,446 @@
 #include <stdint.h>
 #include "miros.h"
 #include "qassert.h"
-#include "stm32f1xx.h"
+#include "miros_port.h"
+#include "miros_config.h"
+#include "miros_deadline.h"
+#include "miros_trace.h"
+#include "miros_event.h"
+#include "miros_sporadic.h"
+#include "miros_server.h"
+#include "miros_ceiling.h"
+#include "miros_channel.h"
+#include "miros_chain.h"
 
 Q_DEFINE_THIS_FILE
 
-#define NUM_MAX_PERIODIC_TASKS 10
-#define NUM_MAX_APERIODIC_TASKS 10
-#define NUM_MAX_NESTED_CRITICAL_REGIONS 10
-
 OSThread * volatile OS_curr; /* pointer to the current thread */
 OSThread * volatile OS_next; /* pointer to the next thread to run */
 
 OSThread *OS_tasks[NUM_MAX_PERIODIC_TASKS + 2]; /* array of tasks*/
-OSThread *OS_aperiodic_tasks[NUM_MAX_APERIODIC_TASKS]; /* array of aperiodics tasks */
+
+/* Aperiodic job queue
+* A ring buffer with one free slot: OSAperiodic_task_start (tasks and
+* interrupt handlers) writes at OS_aperiodicTail, the job at
+* OS_aperiodicHead is the one that runs and OS_finished_aperiodic_task
+* advances the head. Both operations are O(1), and the producers mask
+* interrupts only to store the pointer and move the tail.
+*/
+OSThread * volatile OS_aperiodic_tasks[NUM_MAX_APERIODIC_TASKS]; /* queue of aperiodics tasks */
+uint32_t OS_aperiodicDeadline[NUM_MAX_APERIODIC_TASKS]; /* TBS deadline of each queued job */
+uint8_t volatile OS_aperiodicHead = 0; /* next job to run */
+uint8_t volatile OS_aperiodicTail = 0; /* next free slot */
+#define OS_APERIODIC_NEXT(i) (((i) + 1U == NUM_MAX_APERIODIC_TASKS) ? 0U : ((i) + 1U))
+#define OS_APERIODIC_PENDING() (OS_aperiodicHead != OS_aperiodicTail) /* the queue holds a job */
+
 uint32_t OS_readySet = 0; /* bitmask of threads that are ready to run */
 uint32_t OS_delayedSet = 0; /* bitmask of threads that are delayed */
 uint32_t OS_waiting_next_periodSet = 0; /* bitmask of threads that are waiting next period */
 uint8_t number_periodic_tasks = 0;
-uint8_t number_aperiodic_tasks = 0;
-
-// Priority and index in OS_tasks array of a task in critical region
-#define PRIORITY_CRITICAL_REGION_NPP NUM_MAX_PERIODIC_TASKS+1
 
+/* Release-time wheel
+* Slot (tick % OS_WHEEL_SIZE) holds the bitmask of the threads with a
+* periodic release (OS_releaseWheel) or an OS_delay timeout (OS_timeoutWheel)
+* due on that slot. OS_tick only visits the slot of the current tick and
+* checks the exact tick of each thread found there, so a tick without
+* events costs a couple of loads and a tick with k events costs O(k).
+* Events further away than OS_WHEEL_SIZE ticks just stay in their slot.
+*/
+#define OS_WHEEL_SIZE 64U /* must be a power of 2 */
+#define OS_WHEEL_SLOT(tick) ((tick) & (OS_WHEEL_SIZE - 1U))
+
+uint32_t volatile OS_tickCtr = 0; /* ticks since OS_run */
+uint32_t OS_releaseWheel[OS_WHEEL_SIZE];
+uint32_t OS_timeoutWheel[OS_WHEEL_SIZE];
+uint32_t OS_releaseTick[NUM_MAX_PERIODIC_TASKS]; /* next release of each periodic task, by bit */
+
+/* Deadline monitoring (see miros_deadline.h)
+* The deadline of every released job is put on OS_deadlineWheel as well.
+* OS_tick checks it before the releases of the same tick, so with
+* deadline == period a late job is seen before its next release.
+*/
+typedef struct {
+    OSThread *thread;
+    OSThreadHandler threadHandler; /* to restart an aborted job */
+    void *stkSto;
+    uint32_t stkSize;
+    OS_deadline_policy policy;
+    OS_deadlineHandler handler;
+    OSThread_deadline_stats stats;
+    uint8_t sporadic; /* released by OS_sporadic_release, not by the tick */
+    uint8_t arrivedEarly; /* sporadic arrival before OS_run, released by it */
+    uint8_t chained; /* released by the completion of its predecessor */
+    uint8_t abortHold; /* OS_deadline_abort_hold nesting, the job can't be aborted */
+    OSThread *chainNext; /* successor in a chain */
+    uint32_t chainStart; /* release tick of the head job of the chain instance */
+    OS_chain_stats chainStats; /* tail of a chain only */
+#ifdef MIROS_TRACE
+    uint32_t chainStartCycles;
+    OS_trace_stat chainTrace;
+#endif
+} OSThread_deadline_info;
+
+uint32_t OS_deadlineWheel[OS_WHEEL_SIZE];
+uint32_t OS_deadlineTick[NUM_MAX_PERIODIC_TASKS]; /* absolute deadline of the current job, by bit */
+uint32_t OS_lateSet = 0; /* bitmask of threads running a job past its deadline */
+uint32_t OS_abortSet = 0; /* bitmask of aborted threads waiting to be restarted */
+OSThread_deadline_info OS_deadlineInfo[NUM_MAX_PERIODIC_TASKS]; /* in start order */
+OSThread_deadline_info *OS_deadlineInfoOf[NUM_MAX_PERIODIC_TASKS]; /* by bit, set by OS_run */
+
+/* Sporadic tasks (see miros_sporadic.h)
+* A sporadic task has no release on OS_releaseWheel. Its OS_releaseTick is
+* the earliest tick of its next release, the last release plus the minimum
+* inter-arrival time. An arrival before that tick is deferred to it on the
+* release wheel and its bit is kept in OS_sporadicPendingSet meanwhile.
+*/
+uint32_t OS_sporadicSet = 0; /* bitmask of the sporadic tasks */
+uint32_t OS_sporadicPendingSet = 0; /* bitmask of the sporadic tasks with a deferred release */
+
+/* Aperiodic server (see miros_server.h)
+* The server takes a periodic slot in OS_tasks with OS_serverThread, which
+* has no context of its own: when OS_sched picks it, the aperiodic job at
+* the head of the queue runs instead. Its bit is ready only while the
+* queue is not empty and OS_serverBudget is not exhausted. OS_tick charges
+* a whole tick for every tick in which a job was dispatched at the server
+* priority, even for part of it, so the server never runs over its
+* capacity, and refills the budget on the server releases.
+* The bandwidth servers (EDF only) have no release: OS_deadlineTick of the
+* server is the deadline of the job at the head of the queue (TBS), or the
+* CBS deadline, which is postponed by T_s when the budget runs out. It is
+* mirrored in OS_serverParameters.deadline_dinamic.
+*/
+OS_server_policy OS_serverPolicy = OS_SERVER_BACKGROUND;
+OSThread OS_serverThread;
+OSThread_periodics_task_parameters OS_serverParameters;
+uint32_t OS_serverCapacity = 0; /* ticks per period */
+uint32_t OS_serverBudget = 0; /* ticks left in this period */
+uint8_t OS_serverRan = 0; /* a job ran at the server priority in this tick */
+uint32_t OS_serverLastDeadline = 0; /* TBS deadline of the last arrival */
+
+/* the server has no periodic release */
+#define OS_SERVER_BANDWIDTH() (OS_serverPolicy >= OS_SERVER_TBS)
+
+/* Semaphore wait set
+* A thread blocked in sem_down has its bit in OS_semBlockedSet and the
+* semaphore it waits on in OS_semBlockedOn. sem_up scans the set from the
+* highest priority down and hands the token straight to the first waiter
+* of that semaphore, so the value is only incremented when nobody waits.
+*/
+uint32_t OS_semBlockedSet = 0; /* bitmask of threads blocked on a semaphore */
+semaphore_t *OS_semBlockedOn[NUM_MAX_PERIODIC_TASKS]; /* semaphore each blocked thread waits on, by bit */
+
+/* Critical regions
+* critical_regions_historic[0] of a thread is its priority and
+* critical_regions_historic[n] the level it runs at inside its n-th nested
+* region: PRIORITY_CRITICAL_REGION_NPP for sem_down, the higher of the
+* previous level and the ceiling for mutex_lock (see miros_ceiling.h).
+* OS_regionDepth holds n, by priority (0 is the aperiodic job at the head
+* of the queue), so entering and leaving a region are O(1). A thread
+* running on a ceiling above its priority has its bit in OS_ceilingSet.
+*/
+uint8_t OS_regionDepth[NUM_MAX_PERIODIC_TASKS + 1]; /* nesting depth, by priority */
+uint32_t OS_ceilingSet = 0; /* bitmask of threads raised to a ceiling */
+mutex_t *OS_mutexList = (mutex_t *)0; /* mutexes with declared users */
+
+#ifdef MIROS_PORT_POSIX
+/* CLZ of 0 is 32 on ARM, but __builtin_clz(0) is undefined on the host */
+#define LOG2(x) (((x) != 0U) ? (32U - __builtin_clz(x)) : 0U)
+#else
 #define LOG2(x) (32U - __builtin_clz(x))
+#endif
+
+#ifdef MIROS_EDF
+/* Earliest Deadline First
+* The ready periodic tasks are also kept in a binary min-heap ordered by
+* the absolute deadline of their current job, so OS_sched reads the
+* earliest deadline at the root and a task enters or leaves the ready
+* state in O(log n). Equal deadlines go to the higher RM priority.
+* The NPP slot of a critical region still preempts every task.
+*/
+uint8_t OS_edfHeap[NUM_MAX_PERIODIC_TASKS]; /* priorities of the ready tasks, heap ordered */
+uint8_t OS_edfPos[NUM_MAX_PERIODIC_TASKS]; /* heap index + 1 of each task, 0 if not ready, by bit */
+uint8_t OS_edfCount = 0;
+
+/* job of prio a is due before job of prio b */
+static int OS_edf_before(uint8_t a, uint8_t b) {
+    int32_t diff = (int32_t)(OS_deadlineTick[a - 1U] - OS_deadlineTick[b - 1U]);
+    return (diff < 0) || ((diff == 0) && (a > b));
+}
+
+static void OS_edf_place(uint8_t i, uint8_t prio) {
+    OS_edfHeap[i] = prio;
+    OS_edfPos[prio - 1U] = i + 1U;
+}
+
+static void OS_edf_sift_up(uint8_t i) {
+    uint8_t prio = OS_edfHeap[i];
+
+    while (i > 0U) {
+        uint8_t parent = (i - 1U) / 2U;
+        if (!OS_edf_before(prio, OS_edfHeap[parent])) {
+            break;
+        }
+        OS_edf_place(i, OS_edfHeap[parent]);
+        i = parent;
+    }
+    OS_edf_place(i, prio);
+}
+
+static void OS_edf_sift_down(uint8_t i) {
+    uint8_t prio = OS_edfHeap[i];
+
+    while ((2U * i) + 1U < OS_edfCount) {
+        uint8_t child = (2U * i) + 1U;
+        if ((child + 1U < OS_edfCount)
+            && OS_edf_before(OS_edfHeap[child + 1U], OS_edfHeap[child])) {
+            child++;
+        }
+        if (!OS_edf_before(OS_edfHeap[child], prio)) {
+            break;
+        }
+        OS_edf_place(i, OS_edfHeap[child]);
+        i = child;
+    }
+    OS_edf_place(i, prio);
+}
+#endif /* MIROS_EDF */
+
+/* make a periodic task ready, or re-sort it if its deadline moved */
+static void OS_ready_insert(uint8_t prio) {
+    OS_readySet |= (1U << (prio - 1U));
+#ifdef MIROS_EDF
+    if (OS_edfPos[prio - 1U] == 0U) {
+        OS_edf_place(OS_edfCount, prio);
+        OS_edfCount++;
+    }
+    OS_edf_sift_up(OS_edfPos[prio - 1U] - 1U);
+    OS_edf_sift_down(OS_edfPos[prio - 1U] - 1U);
+#endif
+}
+
+static void OS_ready_remove(uint8_t prio) {
+    OS_readySet &= ~(1U << (prio - 1U));
+#ifdef MIROS_EDF
+    if (OS_edfPos[prio - 1U] != 0U) {
+        uint8_t i = OS_edfPos[prio - 1U] - 1U;
+
+        OS_edfPos[prio - 1U] = 0U;
+        OS_edfCount--;
+
+        /* move the last leaf into the hole */
+        if (i < OS_edfCount) {
+            uint8_t last = OS_edfHeap[OS_edfCount];
+            OS_edf_place(i, last);
+            OS_edf_sift_up(i);
+            OS_edf_sift_down(OS_edfPos[last - 1U] - 1U);
+        }
+    }
+#endif
+}
+
+/* a job is still not finished at its deadline, apply the policy of the task */
+static void OS_deadline_miss(OSThread *t) {
+    uint32_t bit = (1U << (t->prio - 1U));
+    OSThread_deadline_info *info = OS_deadlineInfoOf[t->prio - 1U];
+
+    info->stats.misses++;
+
+    /* a job holding a critical region or an abort hold can't be abandoned */
+    if ((info->policy == OS_DEADLINE_ABORT)
+        && (OS_regionDepth[t->prio] == 0U) && (info->abortHold == 0U)) {
+
+        OS_ready_remove(t->prio);
+        if ((OS_delayedSet & bit) != 0U) {
+            OS_delayedSet &= ~bit;
+            OS_timeoutWheel[OS_WHEEL_SLOT(t->timeout)] &= ~bit;
+        }
+        if ((OS_semBlockedSet & bit) != 0U) {
+            OS_semBlockedSet &= ~bit;
+            OS_semBlockedOn[t->prio - 1U] = (semaphore_t *) 0;
+        }
+        OS_waiting_next_periodSet |= bit;
+        OS_abortSet |= bit; /* restarted by OS_deadline_restart */
+    } else {
+        OS_lateSet |= bit; /* the lateness is taken when the job completes */
+        if ((info->policy == OS_DEADLINE_CALLBACK)
+            && (info->handler != (OS_deadlineHandler)0)) {
+            (*info->handler)(t);
+        }
+    }
+}
+
+/* rebuild the context of the aborted threads, except the one whose
+* stack is in use (the running thread, interrupted by this tick)
+*/
+static void OS_deadline_restart(void) {
+    uint32_t workingSet = OS_abortSet;
+
+    while (workingSet != 0U) {
+        OSThread *t = OS_tasks[LOG2(workingSet)];
+        uint32_t bit = (1U << (t->prio - 1U));
+
+        if (t != OS_curr) {
+            OSThread_deadline_info *info = OS_deadlineInfoOf[t->prio - 1U];
+            OS_port_thread_init(t, info->threadHandler, info->stkSto, info->stkSize);
+            OS_abortSet &= ~bit;
+        }
+        workingSet &= ~bit; /* remove from working set */
+    }
+}
+
+#ifdef MIROS_TRACE
+/* Tracing (see miros_trace.h)
+* OS_traceJob holds the timestamps of the job in progress of each periodic
+* task; the samples go to OS_traceStats when the job completes.
+*/
+typedef struct {
+    uint32_t release;  /* timestamp of the release */
+    uint32_t runStart; /* timestamp of the last switch in */
+    uint32_t exec;     /* run time of the job before runStart */
+    uint8_t running;   /* switched in */
+    uint8_t started;   /* dispatched since the release */
+} OSThread_trace_job;
+
+OSThread_trace_job OS_traceJob[NUM_MAX_PERIODIC_TASKS]; /* by bit */
+OSThread_trace_stats OS_traceStats[NUM_MAX_PERIODIC_TASKS]; /* by bit */
+
+/* the aperiodic tasks and the idle thread are not traced */
+static uint8_t OS_trace_bit_of(OSThread const *t) {
+    if ((t != (OSThread *)0) && (t->prio != 0U)
+        && (t->prio <= number_periodic_tasks) && (OS_tasks[t->prio] == t)) {
+        return t->prio;
+    }
+    return 0U;
+}
+
+void OS_trace_sample(OS_trace_stat *stat, uint32_t value) {
+    if ((stat->count == 0U) || (value < stat->min)) {
+        stat->min = value;
+    }
+    if (value > stat->max) {
+        stat->max = value;
+    }
+    stat->count++;
+    stat->sum += value;
+}
+
+void OS_trace_switch(void) {
+    uint32_t now = OS_port_cycles();
+    uint8_t prio = OS_trace_bit_of(OS_curr);
+
+    if (prio != 0U) {
+        OSThread_trace_job *job = &OS_traceJob[prio - 1U];
+        if (job->running) {
+            job->exec += now - job->runStart;
+            job->running = 0U;
+        }
+    }
+
+    prio = OS_trace_bit_of(OS_next);
+    if (prio != 0U) {
+        OSThread_trace_job *job = &OS_traceJob[prio - 1U];
+        job->runStart = now;
+        job->running = 1U;
+        if (!job->started) {
+            job->started = 1U;
+            OS_trace_sample(&OS_traceStats[prio - 1U].start, now - job->release);
+        }
+    }
+}
+
+static void OS_trace_release(uint8_t prio) {
+    OSThread_trace_job *job = &OS_traceJob[prio - 1U];
+
+    job->release = OS_port_cycles();
+    job->exec = 0U;
+    job->runStart = job->release;
+    job->started = 0U;
+
+    /* released while still switched in, the job starts right away */
+    if (job->running) {
+        job->started = 1U;
+        OS_trace_sample(&OS_traceStats[prio - 1U].start, 0U);
+    }
+}
+
+static void OS_trace_complete(uint8_t prio) {
+    OSThread_trace_job *job = &OS_traceJob[prio - 1U];
+    uint32_t now = OS_port_cycles();
+    uint32_t exec = job->exec;
+
+    if (job->running) {
+        exec += now - job->runStart;
+    }
+    OS_trace_sample(&OS_traceStats[prio - 1U].exec, exec);
+    OS_trace_sample(&OS_traceStats[prio - 1U].response, now - job->release);
+
+    /* the kernel code that follows is not part of the next job */
+    job->exec = 0U;
+    job->runStart = now;
+}
+#endif /* MIROS_TRACE */
+
+#ifdef MIROS_TICKLESS
+/* ticks from now to the next periodic release, OS_delay timeout
+* or deadline of an unfinished job
+*/
+static uint32_t OS_next_event(void) {
+    uint32_t next = 0xFFFFFFFFU;
+    uint32_t workingSet = OS_delayedSet;
+
+    for (uint8_t prio = 1U; prio <= number_periodic_tasks; prio++) {
+        uint32_t ticks = OS_releaseTick[prio - 1U] - OS_tickCtr;
+        if (OS_SERVER_BANDWIDTH() && (OS_tasks[prio] == &OS_serverThread)) {
+            continue; /* no release and no deadline check */
+        }
+        if ((ticks < next)
+            && (((OS_sporadicSet & ~OS_sporadicPendingSet) & (1U << (prio - 1U))) == 0U)) {
+            next = ticks;
+        }
+        if ((OS_waiting_next_periodSet & (1U << (prio - 1U))) == 0U) {
+            ticks = OS_deadlineTick[prio - 1U] - OS_tickCtr;
+            if (ticks < next) {
+                next = ticks;
+            }
+        }
+    }
+    while (workingSet != 0U) {
+        OSThread *t = OS_tasks[LOG2(workingSet)];
+        uint32_t ticks = t->timeout - OS_tickCtr;
+        if (ticks < next) {
+            next = ticks;
+        }
+        workingSet &= ~(1U << (t->prio - 1U)); /* remove from working set */
+    }
+    return next;
+}
+
+/* sleep through the ticks without events, the port delivers the tick
+* of the next event as a normal SysTick interrupt
+*/
+static void OS_idle_sleep(void) {
+    __disable_irq();
+    if ((OS_readySet == 0U) && !OS_APERIODIC_PENDING()) {
+        /* nothing is due on the skipped ticks, only count them */
+        OS_tickCtr += OS_port_sleep(OS_next_event());
+    } else {
+        /* a tick taken before a pending switch to idle made a thread
+        * ready again, which OS_sched saw as still running
+        */
+        OS_sched();
+    }
+    __enable_irq();
+}
+#endif /* MIROS_TICKLESS */
 
 OSThread idleThread;
 void main_idleThread() {
     while (1) {
+#ifdef MIROS_TICKLESS
+        OS_idle_sleep();
+#else
         OS_onIdle();
+#endif
     }
 }
 void OS_error(){
@@ -67,8 +479,8 @@ void OS_error(){
 	while(1);
 }
 void OS_init(void *stkSto, uint32_t stkSize) {
-    /* set the PendSV interrupt priority to the lowest level 0xFF */
-    *(uint32_t volatile *)0xE000ED20 |= (0xFFU << 16);
+    /* let the port set up the context switch (PendSV on Cortex-M3) */
+    OS_port_init();
 
     /* start idleThread thread */
     OSPeriodic_task_start(&idleThread,
@@ -76,13 +488,229 @@ void OS_init(void *stkSto, uint32_t stkSize) {
                    stkSto, stkSize);
 }
 
+/* start a new job of a task waiting for its release, its deadline counts
+* from now. Called with interrupts disabled.
+*/
+static void OS_release_job(uint8_t prio) {
+    uint32_t bit = (1U << (prio - 1U));
+    OSThread *t = OS_tasks[prio];
+
+    OS_deadlineTick[prio - 1U] = OS_tickCtr + t->task_parameters->deadline_absolute;
+    OS_deadlineWheel[OS_WHEEL_SLOT(OS_deadlineTick[prio - 1U])] |= bit;
+    OS_ready_insert(prio); /* insert to set */
+    OS_waiting_next_periodSet &= ~bit; /* remove from set */
+#ifdef MIROS_TRACE
+    OS_trace_release(prio);
+#endif
+
+    /* a chain instance starts with the release of its head */
+    if (!OS_deadlineInfoOf[prio - 1U]->chained) {
+        OS_deadlineInfoOf[prio - 1U]->chainStart = OS_tickCtr;
+#ifdef MIROS_TRACE
+        OS_deadlineInfoOf[prio - 1U]->chainStartCycles = OS_traceJob[prio - 1U].release;
+#endif
+    }
+}
+
+/* an arrival of a sporadic task, released now or at its minimum
+* inter-arrival time. Returns 0 if it was dropped. Called with interrupts
+* disabled.
+*/
+static uint8_t OS_sporadic_arrival(uint8_t prio) {
+    uint32_t bit = (1U << (prio - 1U));
+    OSThread_deadline_info *info = OS_deadlineInfoOf[prio - 1U];
+
+    Q_REQUIRE(info->sporadic);
+
+    if (((OS_waiting_next_periodSet & ~OS_abortSet & ~OS_sporadicPendingSet) & bit) == 0U) {
+        /* a job is in progress or already due, drop this arrival */
+        info->stats.skipped++;
+        return 0U;
+    }
+    if ((int32_t)(OS_releaseTick[prio - 1U] - OS_tickCtr) > 0) {
+        /* too early, release at the minimum inter-arrival time */
+        OS_sporadicPendingSet |= bit;
+        OS_releaseWheel[OS_WHEEL_SLOT(OS_releaseTick[prio - 1U])] |= bit;
+    } else {
+        OS_release_job(prio);
+        OS_releaseTick[prio - 1U] = OS_tickCtr + OS_tasks[prio]->task_parameters->period_absolute;
+    }
+    return 1U;
+}
+
+/* a job of a chained task completed: release the successor with the
+* same chain instance, or close the instance at the tail
+*/
+static void OS_chain_complete(OSThread_deadline_info *info) {
+    if (info->chainNext != (OSThread *)0) {
+        uint8_t prio = info->chainNext->prio;
+
+        if (OS_sporadic_arrival(prio)) {
+            OS_deadlineInfoOf[prio - 1U]->chainStart = info->chainStart;
+#ifdef MIROS_TRACE
+            OS_deadlineInfoOf[prio - 1U]->chainStartCycles = info->chainStartCycles;
+#endif
+        }
+    } else {
+        /* completed in the tick after OS_tickCtr, rounded up */
+        uint32_t latency = OS_tickCtr - info->chainStart + 1U;
+        OS_chain_stats *stats = &info->chainStats;
+
+        if ((stats->count == 0U) || (latency < stats->latency_min)) {
+            stats->latency_min = latency;
+        }
+        if (latency > stats->latency_max) {
+            stats->latency_max = latency;
+        }
+        stats->latency_last = latency;
+        stats->count++;
+#ifdef MIROS_TRACE
+        OS_trace_sample(&info->chainTrace, OS_port_cycles() - info->chainStartCycles);
+#endif
+    }
+}
+
+/* move the server deadline, reordering the server if it is ready */
+static void OS_server_deadline_set(uint32_t deadline) {
+    uint8_t prio = OS_serverThread.prio;
+
+    OS_deadlineTick[prio - 1U] = deadline;
+    OS_serverParameters.deadline_dinamic = deadline;
+    if ((OS_readySet & (1U << (prio - 1U))) != 0U) {
+        OS_ready_insert(prio);
+    }
+}
+
+/* charge the tick that ended to the server, if a job ran at the server
+* priority during it
+*/
+static void OS_server_charge(void) {
+    uint8_t prio = OS_serverThread.prio;
+
+    if (OS_serverRan && (OS_serverBudget != 0U)) {
+        if (--OS_serverBudget != 0U) {
+            /* capacity left */
+        } else if (OS_serverPolicy == OS_SERVER_CBS) {
+            /* a new budget with the deadline one period later */
+            OS_serverBudget = OS_serverCapacity;
+            OS_server_deadline_set(OS_deadlineTick[prio - 1U]
+                                   + OS_serverParameters.period_absolute);
+        } else {
+            OS_ready_remove(prio);
+        }
+    }
+
+    /* the OS_sched that follows the tick sets it again if the server
+    * keeps the CPU, a server preempted at the tick is not charged
+    */
+    OS_serverRan = 0U;
+}
+
+/* start of a server period, its deadline is the end of the period */
+static void OS_server_replenish(void) {
+    uint8_t prio = OS_serverThread.prio;
+
+    OS_deadlineTick[prio - 1U] = OS_tickCtr + OS_serverParameters.period_absolute;
+    OS_serverBudget = OS_serverCapacity;
+    OS_ready_remove(prio); /* to reorder it by the new deadline */
+    if (OS_APERIODIC_PENDING()) {
+        OS_ready_insert(prio);
+    } else if (OS_serverPolicy == OS_SERVER_POLLING) {
+        /* nothing to poll, the capacity is lost until the next period */
+        OS_serverBudget = 0U;
+    }
+}
+
+/* a job arrived at an idle bandwidth server */
+static void OS_server_activate(void) {
+    uint8_t prio = OS_serverThread.prio;
+
+    if (OS_serverPolicy == OS_SERVER_TBS) {
+        OS_server_deadline_set(OS_aperiodicDeadline[OS_aperiodicHead]);
+    } else {
+        /* CBS: keep the current budget and deadline only if serving the
+        * budget before the deadline stays within the bandwidth,
+        * budget / (d_s - now) <= C_s / T_s
+        */
+        int32_t left = (int32_t)(OS_deadlineTick[prio - 1U] - OS_tickCtr);
+
+        if ((left <= 0)
+            || ((uint64_t)OS_serverBudget * OS_serverParameters.period_absolute
+                > (uint64_t)(uint32_t)left * OS_serverCapacity)) {
+            OS_serverBudget = OS_serverCapacity;
+            OS_server_deadline_set(OS_tickCtr + OS_serverParameters.period_absolute);
+        }
+    }
+    OS_ready_insert(prio);
+}
+
+/* the task to run instead of prio, picked by the scheduler, when a ready
+* task holds a mutex: prio if it is above the ceiling of every ready
+* holder, else the holder at the highest ceiling or, under EDF (SRP), a
+* task above that ceiling with an earlier deadline
+*/
+static uint8_t OS_ceiling_pick(uint8_t prio) {
+    uint32_t workingSet = OS_ceilingSet & OS_readySet;
+    uint8_t holder = 0U;
+    uint8_t ceiling = 0U;
+
+    while (workingSet != 0U) {
+        uint8_t h = LOG2(workingSet);
+        uint8_t level = OS_tasks[h]->critical_regions_historic[OS_regionDepth[h]];
+
+        if (level > ceiling) {
+            ceiling = level;
+            holder = h;
+        }
+        workingSet &= ~(1U << (h - 1U)); /* remove from working set */
+    }
+    if (prio > ceiling) {
+        return prio;
+    }
+#ifdef MIROS_EDF
+    /* the tasks above the ceiling, the NPP slot is handled before */
+    workingSet = OS_readySet & ~((1U << ceiling) - 1U)
+                 & ~(1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+    while (workingSet != 0U) {
+        uint8_t t = LOG2(workingSet);
+
+        if (OS_edf_before(t, holder)) {
+            holder = t;
+        }
+        workingSet &= ~(1U << (t - 1U)); /* remove from working set */
+    }
+#endif
+    return holder;
+}
+
 // Calculate the next task index (the position in OS_Thread array of next task) 
 void OS_wait_next_period(){
     __disable_irq();
     
-    uint8_t bit = (1U << (OS_curr->prio - 1U));
-    OS_readySet   &= ~bit;  /* insert to set */
-    OS_waiting_next_periodSet |= bit; /* remove from set */
+    uint32_t bit = (1U << (OS_curr->prio - 1U));
+    OSThread_deadline_info *info = OS_deadlineInfoOf[OS_curr->prio - 1U];
+
+    info->stats.jobs++;
+#ifdef MIROS_TRACE
+    OS_trace_complete(OS_curr->prio);
+#endif
+    if ((OS_lateSet & bit) != 0U) {
+        /* completed in the tick after OS_tickCtr, rounded up */
+        uint32_t lateness = OS_tickCtr - OS_deadlineTick[OS_curr->prio - 1U] + 1U;
+
+        OS_lateSet &= ~bit;
+        info->stats.lateness_last = lateness;
+        if (lateness > info->stats.lateness_max) {
+            info->stats.lateness_max = lateness;
+        }
+    }
+
+    if ((info->chainNext != (OSThread *)0) || info->chained) {
+        OS_chain_complete(info);
+    }
+
+    OS_ready_remove(OS_curr->prio);  /* remove from set */
+    OS_waiting_next_periodSet |= bit; /* insert to set */
 
     OS_sched();
     __enable_irq();
@@ -91,21 +719,25 @@ void OS_wait_next_period(){
 void OS_finished_aperiodic_task(void){
     __disable_irq();
 
-    if (number_aperiodic_tasks == 1){
-    	OS_aperiodic_tasks[0] = (OSThread *) 0;
+    /* only the job at the head of the queue runs */
+    Q_REQUIRE((OS_aperiodicHead != OS_aperiodicTail)
+              && (OS_aperiodic_tasks[OS_aperiodicHead] == OS_curr));
 
-    } else {
-		// Update the queue array of aperiodic tasks
-		for (uint8_t i = 1; i <= number_aperiodic_tasks; i++){
-			OS_aperiodic_tasks[i-1] = OS_aperiodic_tasks[i];
-			OS_aperiodic_tasks[i-1]->prio = i-1;
-			OS_aperiodic_tasks[i-1]->critical_regions_historic[0] = i-1;
-			OS_aperiodic_tasks[i] = (OSThread *) 0;
-		}
-    }
+    OS_aperiodic_tasks[OS_aperiodicHead] = (OSThread *) 0;
+    OS_aperiodicHead = OS_APERIODIC_NEXT(OS_aperiodicHead);
 
-    // Decreasing number of aperiodic tasks
-    number_aperiodic_tasks--;
+    /* the server suspends when the queue runs empty, a polling server
+    * gives up the rest of its capacity
+    */
+    if ((OS_serverPolicy != OS_SERVER_BACKGROUND) && !OS_APERIODIC_PENDING()) {
+        OS_ready_remove(OS_serverThread.prio);
+        if (OS_serverPolicy == OS_SERVER_POLLING) {
+            OS_serverBudget = 0U;
+        }
+    } else if (OS_serverPolicy == OS_SERVER_TBS) {
+        /* the server takes the deadline of the next job */
+        OS_server_deadline_set(OS_aperiodicDeadline[OS_aperiodicHead]);
+    }
 
     OS_sched();
     __enable_irq();
@@ -114,14 +746,30 @@ void OS_finished_aperiodic_task(void){
 
 void OS_sched(void) {
     OSThread *next;
+#ifdef MIROS_EDF
+    uint8_t OS_Periodic_task_running_index = 0U;
+
+    if ((OS_readySet & (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U))) != 0U) {
+        OS_Periodic_task_running_index = PRIORITY_CRITICAL_REGION_NPP;
+    } else if (OS_edfCount != 0U) {
+        OS_Periodic_task_running_index = OS_edfHeap[0]; /* earliest deadline */
+    }
+#else
     uint8_t OS_Periodic_task_running_index = LOG2(OS_readySet);
+#endif
+
+    // A task holding a mutex keeps the tasks up to its ceiling waiting
+    if (((OS_ceilingSet & OS_readySet) != 0U)
+        && (OS_Periodic_task_running_index != PRIORITY_CRITICAL_REGION_NPP)) {
+        OS_Periodic_task_running_index = OS_ceiling_pick(OS_Periodic_task_running_index);
+    }
 
     // If there is not any periodic task ready to sched
     if (OS_Periodic_task_running_index == 0U) {
 
         // If there is an aperiodic task to be executable 
-        if (number_aperiodic_tasks){
-            next = OS_aperiodic_tasks[0];
+        if (OS_aperiodicHead != OS_aperiodicTail){
+            next = OS_aperiodic_tasks[OS_aperiodicHead];
 
         } else {
             next = OS_tasks[0]; /* the idle thread */
@@ -129,27 +777,92 @@ void OS_sched(void) {
 
     } else {
         next = OS_tasks[OS_Periodic_task_running_index];
+
+        // The server runs the aperiodic job at the head of the queue
+        if (next == &OS_serverThread) {
+            next = OS_aperiodic_tasks[OS_aperiodicHead];
+            OS_serverRan = 1U;
+        }
     }
 
     Q_ASSERT(next != (OSThread *)0);
 
-    /* trigger PendSV, if needed */
+    /* trigger the context switch, if needed */
     if (next != OS_curr) {
         OS_next = next;
-        //*(uint32_t volatile *)0xE000ED04 = (1U << 28);
-        SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
-        __asm volatile("dsb");
-//        __asm volatile("isb");
+        OS_port_context_switch();
     }
-    /*
-     * DSB - whenever a memory access needs to have completed before program execution progresses.
-     * ISB - whenever instruction fetches need to explicitly take place after a certain point in the program,
-     * for example after memory map updates or after writing code to be executed.
-     * (In practice, this means "throw away any prefetched instructions at this point".)
-     * */
 }
 
 void OS_run(void) {
+    /* the priorities are final only after all tasks were started,
+    * so the periodic tasks are made ready and their first release is
+    * put on the wheel here, period_dinamic being the initial phase
+    */
+    for (uint8_t i = 1; i <= number_periodic_tasks; i++){
+        /* the records are in start order, the kernel looks them up by bit */
+        OSThread_deadline_info *info = &OS_deadlineInfo[i - 1U];
+        OS_deadlineInfoOf[info->thread->prio - 1U] = info;
+    }
+    for (mutex_t *m = OS_mutexList; m != (mutex_t *)0; m = m->next) {
+        /* the ceiling is the highest priority of the users */
+        for (uint8_t i = 0U; i < number_periodic_tasks; i++) {
+            if (((m->users & (1U << i)) != 0U)
+                && (OS_deadlineInfo[i].thread->prio > m->ceiling)) {
+                m->ceiling = OS_deadlineInfo[i].thread->prio;
+            }
+        }
+    }
+    for (uint8_t i = 1; i <= number_periodic_tasks; i++){
+        OSThread *t = OS_tasks[i];
+        uint32_t bit = (1U << (t->prio - 1U));
+
+        Q_REQUIRE((t->task_parameters->period_absolute != 0U)
+                  && (t->task_parameters->deadline_absolute != 0U)
+                  && (t->task_parameters->deadline_absolute
+                      <= t->task_parameters->period_absolute));
+
+        /* a bandwidth server waits for the first arrival */
+        if ((t == &OS_serverThread) && OS_SERVER_BANDWIDTH()) {
+            OS_serverBudget = OS_serverCapacity;
+            OS_server_deadline_set(OS_tickCtr);
+            if (OS_APERIODIC_PENDING()) {
+                OS_server_activate();
+            }
+            continue;
+        }
+
+        /* the server starts its first period with the full capacity */
+        if (t == &OS_serverThread) {
+            OS_releaseTick[t->prio - 1U] = OS_tickCtr + t->task_parameters->period_absolute;
+            OS_releaseWheel[OS_WHEEL_SLOT(OS_releaseTick[t->prio - 1U])] |= bit;
+            OS_server_replenish();
+            continue;
+        }
+
+        /* a sporadic task waits for its first arrival, which may come at
+        * once or may have come before OS_run (an interrupt enabled while
+        * the application was set up)
+        */
+        if (OS_deadlineInfoOf[t->prio - 1U]->sporadic) {
+            __disable_irq();
+            OS_sporadicSet |= bit;
+            OS_releaseTick[t->prio - 1U] = OS_tickCtr;
+            OS_waiting_next_periodSet |= bit;
+            if (OS_deadlineInfoOf[t->prio - 1U]->arrivedEarly) {
+                OS_deadlineInfoOf[t->prio - 1U]->arrivedEarly = 0U;
+                (void)OS_sporadic_arrival(t->prio);
+            }
+            __enable_irq();
+            continue;
+        }
+        Q_REQUIRE(t->task_parameters->period_dinamic != 0U);
+
+        OS_releaseTick[t->prio - 1U] = OS_tickCtr + t->task_parameters->period_dinamic;
+        OS_releaseWheel[OS_WHEEL_SLOT(OS_releaseTick[t->prio - 1U])] |= bit;
+        OS_release_job(t->prio);
+    }
+
     /* callback to configure and start interrupts */
     OS_onStartup();
 
@@ -162,54 +875,114 @@ void OS_run(void) {
 }
 
 void OS_tick(void) {
+    uint32_t slot = OS_WHEEL_SLOT(++OS_tickCtr);
+    uint32_t workingSet;
 
-    uint32_t workingSet = OS_delayedSet;
+    if ((OS_serverPolicy != OS_SERVER_BACKGROUND)
+        && (OS_serverPolicy != OS_SERVER_TBS)) {
+        OS_server_charge();
+    }
+
+    /* nothing due on this slot, the common case */
+    if ((OS_timeoutWheel[slot] | OS_releaseWheel[slot] | OS_deadlineWheel[slot]) == 0U) {
+        if (OS_abortSet != 0U) {
+            OS_deadline_restart();
+        }
+        return;
+    }
+
+    workingSet = OS_timeoutWheel[slot];
     while (workingSet != 0U) {
         OSThread *t = OS_tasks[LOG2(workingSet)];
         uint32_t bit;
-        Q_ASSERT((t != (OSThread *)0) && (t->timeout != 0U));
+        Q_ASSERT(t != (OSThread *)0);
 
         bit = (1U << (t->prio - 1U));
-        --t->timeout;
-        if (t->timeout == 0U) {
-            OS_readySet   |= bit;  /* insert to set */
+        if (t->timeout == OS_tickCtr) {
+            OS_ready_insert(t->prio); /* insert to set */
             OS_delayedSet &= ~bit; /* remove from set */
+            OS_timeoutWheel[slot] &= ~bit;
+
+            /* a thread delayed inside a critical region resumes with NPP */
+            if (OS_tasks[PRIORITY_CRITICAL_REGION_NPP] == t) {
+                OS_readySet |= (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+            }
         }
         workingSet &= ~bit; /* remove from working set */
     }
 
-    /* Update the dinamics parameters os periodics tasks */
-    for (int i = 1; i <= number_periodic_tasks; i++){
-        OSThread *t = OS_tasks[i];
+    /* Check the deadlines due on this tick, before the releases */
+    workingSet = OS_deadlineWheel[slot];
+    while (workingSet != 0U) {
+        OSThread *t = OS_tasks[LOG2(workingSet)];
+        uint32_t bit = (1U << (t->prio - 1U));
 
-        t->task_parameters->deadline_dinamic--;
-        t->task_parameters->period_dinamic--;
+        if (OS_deadlineTick[t->prio - 1U] == OS_tickCtr) {
+            OS_deadlineWheel[slot] &= ~bit;
+            if ((OS_waiting_next_periodSet & bit) == 0U) {
+                OS_deadline_miss(t);
+            }
+        }
+        workingSet &= ~bit; /* remove from working set */
+    }
 
-        if (t->task_parameters->period_dinamic == 0){
-            uint32_t bit = (1U << (t->prio - 1U));
+    /* aborted jobs get a fresh context before the releases of this tick */
+    if (OS_abortSet != 0U) {
+        OS_deadline_restart();
+    }
 
-            OS_readySet   |= bit;  /* insert to set */
-            OS_waiting_next_periodSet &= ~bit; /* remove from set */
+    /* Release the periodics tasks due on this tick */
+    workingSet = OS_releaseWheel[slot];
+    while (workingSet != 0U) {
+        OSThread *t = OS_tasks[LOG2(workingSet)];
+        uint32_t bit = (1U << (t->prio - 1U));
+
+        if (OS_releaseTick[t->prio - 1U] == OS_tickCtr) {
+            uint32_t next = OS_tickCtr + t->task_parameters->period_absolute;
+
+            if (t == &OS_serverThread) {
+                OS_server_replenish();
+            } else if (((OS_waiting_next_periodSet & ~OS_abortSet) & bit) != 0U) {
+                OS_release_job(t->prio);
+            } else {
+                /* the previous job is late or not restarted yet, drop this one */
+                OS_deadlineInfoOf[t->prio - 1U]->stats.skipped++;
+            }
 
-            t->task_parameters->deadline_dinamic = t->task_parameters->deadline_absolute;
-            t->task_parameters->period_dinamic = t->task_parameters->period_absolute;
+            /* move the task to the slot of its next release,
+            * a deferred sporadic arrival just leaves the wheel
+            */
+            OS_releaseWheel[slot] &= ~bit;
+            if ((OS_sporadicSet & bit) == 0U) {
+                OS_releaseWheel[OS_WHEEL_SLOT(next)] |= bit;
+            }
+            OS_sporadicPendingSet &= ~bit;
+            OS_releaseTick[t->prio - 1U] = next;
         }
+        workingSet &= ~bit; /* remove from working set */
     }
 }
 
 void OS_delay(uint32_t ticks) {
     uint32_t bit;
-    __asm volatile ("cpsid i");
+    __disable_irq();
 
     /* never call OS_delay from the idleThread */
-    Q_REQUIRE(OS_curr != OS_tasks[0]);
+    Q_REQUIRE((OS_curr != OS_tasks[0]) && (ticks != 0U));
 
-    OS_curr->timeout = ticks;
+    /* the timeout is kept as the absolute tick it expires on */
+    OS_curr->timeout = OS_tickCtr + ticks;
     bit = (1U << (OS_curr->prio - 1U));
-    OS_readySet &= ~bit;
+    OS_ready_remove(OS_curr->prio);
     OS_delayedSet |= bit;
+    OS_timeoutWheel[OS_WHEEL_SLOT(OS_curr->timeout)] |= bit;
+
+    /* the NPP slot must not keep a delayed thread running */
+    if (OS_tasks[PRIORITY_CRITICAL_REGION_NPP] == OS_curr) {
+        OS_readySet &= ~(1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+    }
     OS_sched();
-    __asm volatile ("cpsie i");
+    __enable_irq();
 }
 
 /* initialization of the semaphore variable */
@@ -221,129 +994,321 @@ void semaphore_init(semaphore_t *p_semaphore, uint32_t start_value, uint32_t max
 	p_semaphore->max_value = max_value;
 }
 
-/*  */
-void sem_up(semaphore_t *p_semaphore){
-	__disable_irq();
+/* Hand the token to the highest-priority waiter of the semaphore, or keep
+* it in the semaphore if nobody waits. Called with interrupts disabled.
+*/
+static void OS_sem_give(semaphore_t *p_semaphore) {
+    uint32_t workingSet = OS_semBlockedSet;
+    while (workingSet != 0U) {
+        uint8_t prio = LOG2(workingSet);
+        uint32_t bit = (1U << (prio - 1U));
+
+        // Hand the token to the highest-priority waiter of this semaphore
+        if (OS_semBlockedOn[prio - 1U] == p_semaphore) {
+            OS_semBlockedOn[prio - 1U] = (semaphore_t *) 0;
+            OS_semBlockedSet &= ~bit;
+            OS_ready_insert(prio);
+
+            // A waiter blocked inside a critical region resumes with NPP
+            if (OS_tasks[PRIORITY_CRITICAL_REGION_NPP] == OS_tasks[prio]) {
+                OS_readySet |= (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+            }
+            return;
+        }
+        workingSet &= ~bit; /* remove from working set */
+    }
 
+    // Nobody was waiting, keep the token in the semaphore
     if (p_semaphore->sem_value < p_semaphore->max_value)
 	    p_semaphore->sem_value++;
+}
 
+/* Take a token, blocking OS_curr until one is handed over by OS_sem_give.
+* Called with interrupts disabled, returns with interrupts disabled.
+*/
+static void OS_sem_take(semaphore_t *p_semaphore) {
+	if (p_semaphore->sem_value == 0){
+        uint32_t bit;
 
-    // Update the queue of critical_regions_historic array and update the OS_readySet bitmask for schedulling
-    for (uint8_t i = 0; i < NUM_MAX_NESTED_CRITICAL_REGIONS+1; i++){
-       
-        // Update the queue of critical_regions_historic array 
-        OS_curr->critical_regions_historic[i] = OS_curr->critical_regions_historic[i+1];
-        OS_curr->critical_regions_historic[i+1] = 0;
+        /* only periodic tasks have a bit to block on */
+        Q_REQUIRE((OS_curr->prio != 0U) && (OS_tasks[OS_curr->prio] == OS_curr));
 
-        // If 'i' is the end position of array
-        if (OS_curr->critical_regions_historic[i] == OS_curr->prio){
+        bit = (1U << (OS_curr->prio - 1U));
+        OS_semBlockedOn[OS_curr->prio - 1U] = p_semaphore;
+        OS_semBlockedSet |= bit;
+        OS_ready_remove(OS_curr->prio);
 
-            // If there was just one critical region,
-            if (i == 0){
+        /* the NPP slot must not keep a blocked thread running */
+        if (OS_tasks[PRIORITY_CRITICAL_REGION_NPP] == OS_curr) {
+            OS_readySet &= ~(1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+        }
+        OS_sched();
+        __enable_irq();
 
-                // Update the OS_readySet bitmask
-                uint32_t bit = (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
-                OS_readySet &= ~bit;
+        /* resumed by OS_sem_give, which handed the token over to us */
+        __disable_irq();
+	} else {
+	    p_semaphore->sem_value--;
+	}
+}
 
-                // Set a null pointer in the unused position 
-                OS_tasks[PRIORITY_CRITICAL_REGION_NPP] = (OSThread *) 0;
-            }
-            break;
-        }
+/* Enter a critical region at level, or at the level of the enclosing
+* region if that is higher. Called with interrupts disabled.
+*/
+static void OS_region_enter(uint8_t level) {
+    OSThread *me = OS_curr; /* read the volatile pointer once */
+    uint8_t prio = me->prio;
+    uint8_t depth = OS_regionDepth[prio];
+
+    Q_REQUIRE(depth < NUM_MAX_NESTED_CRITICAL_REGIONS);
+
+    if (level < me->critical_regions_historic[depth]) {
+        level = me->critical_regions_historic[depth];
+    }
+    me->critical_regions_historic[depth + 1U] = level;
+    OS_regionDepth[prio] = depth + 1U;
+
+    if (level == PRIORITY_CRITICAL_REGION_NPP) {
+        // Put the thread in the NPP slot and set its bit for schedulling
+        OS_tasks[PRIORITY_CRITICAL_REGION_NPP] = me;
+        OS_readySet |= (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+    } else if (level > prio) {
+        OS_ceilingSet |= (1U << (prio - 1U));
     }
+}
+
+/* Leave the innermost critical region. Called with interrupts disabled. */
+static void OS_region_exit(void) {
+    OSThread *me = OS_curr; /* read the volatile pointer once */
+    uint8_t prio = me->prio;
+    uint8_t depth = OS_regionDepth[prio];
+    uint8_t level;
+
+    Q_REQUIRE(depth != 0U);
+
+    depth--;
+    OS_regionDepth[prio] = depth;
+    level = me->critical_regions_historic[depth];
+
+    // Out of the last NPP region, free the NPP slot
+    if ((level != PRIORITY_CRITICAL_REGION_NPP)
+        && (OS_tasks[PRIORITY_CRITICAL_REGION_NPP] == me)) {
+        OS_readySet &= ~(1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
+        OS_tasks[PRIORITY_CRITICAL_REGION_NPP] = (OSThread *) 0;
+    }
+    if ((level == prio) && (prio != 0U)) {
+        OS_ceilingSet &= ~(1U << (prio - 1U));
+    }
+}
 
+/*  */
+void sem_up(semaphore_t *p_semaphore){
+	__disable_irq();
+
+    OS_sem_give(p_semaphore);
+    OS_region_exit();
+
+    // Switch now if the waiter or a task released in the region preempts us
+    OS_sched();
 	__enable_irq();
 }
 
 void sem_down(semaphore_t *p_semaphore){
 	__disable_irq();
 
+#ifdef MIROS_SEM_POLL
+    // The wait of the kernel before OS_sem_take, kept to compare the two
+    // (Host/bench_sem.c): look at the semaphore again every tick
 	while (p_semaphore->sem_value == 0){
 		OS_delay(1U);
 		__disable_irq();
 	}
+	p_semaphore->sem_value--;
+#else
+    OS_sem_take(p_semaphore);
+#endif
+    OS_region_enter(PRIORITY_CRITICAL_REGION_NPP);
 
-    // Update the queue of critical_regions_historic array and update the OS_readySet bitmask for schedulling
-    for (uint8_t i = 0; i < NUM_MAX_NESTED_CRITICAL_REGIONS+1; i++){
-        
-        // If 'i' is the end position of array
-        if (OS_curr->critical_regions_historic[i] == OS_curr->prio) {
+	__enable_irq();
+}
 
-            // Check if the critical_regions_historic queue is not full
-            Q_REQUIRE(i+1 < NUM_MAX_NESTED_CRITICAL_REGIONS+1);
+void mutex_init(mutex_t *m) {
+    semaphore_init(&m->sem, 1, 1);
+    m->users = 0U;
+    m->ceiling = 0U;
+    m->next = (mutex_t *)0;
+}
 
-            // Update the positions of index
-            for (uint8_t j = i+1; j > 0; j--){
-                OS_curr->critical_regions_historic[j] = OS_curr->critical_regions_historic[j-1];
-            }
+void mutex_lock(mutex_t *m) {
+	__disable_irq();
 
-            // Set the new prioriry of task and put the pointer in OS_tasks array
-            OS_curr->critical_regions_historic[0] = PRIORITY_CRITICAL_REGION_NPP;
-            OS_tasks[PRIORITY_CRITICAL_REGION_NPP] = OS_curr;
+    /* a periodic task must be a declared user */
+    Q_REQUIRE((OS_curr->prio == 0U) || (m->ceiling >= OS_curr->prio));
 
-            // Set the bit of the task in OS_readySet bitmask
-            uint32_t bit = (1U << (PRIORITY_CRITICAL_REGION_NPP - 1U));
-            OS_readySet |= bit;
+    OS_sem_take(&m->sem);
+    OS_region_enter((OS_curr->prio != 0U) ? m->ceiling : PRIORITY_CRITICAL_REGION_NPP);
 
-            break;
-        }
-    }
+	__enable_irq();
+}
 
-	p_semaphore->sem_value--;
+void mutex_unlock(mutex_t *m) {
+	__disable_irq();
+
+    OS_sem_give(&m->sem);
+    OS_region_exit();
+
+    // The tasks up to the ceiling may preempt us now
+    OS_sched();
+	__enable_irq();
+}
 
+/* Signal an event semaphore (see miros_event.h), also from an interrupt */
+void sem_signal(semaphore_t *p_semaphore){
+	__disable_irq();
+    OS_sem_give(p_semaphore);
+    OS_sched();
 	__enable_irq();
 }
 
+/* Wait on an event semaphore, without entering a critical region */
+void sem_pend(semaphore_t *p_semaphore){
+	__disable_irq();
+    OS_sem_take(p_semaphore);
+	__enable_irq();
+}
+
+/* Writer and reader run on the same core, so the compiler is the only one
+* that could reorder the copies around the slot stores
+*/
+#define OS_COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+void channel_init(channel_t *ch, uint8_t size) {
+    Q_REQUIRE((size != 0U) && (size <= OS_CHANNEL_MAX_SIZE));
+
+    for (uint8_t i = 0U; i < 3U; ++i) {
+        ch->number[i] = 0U;
+    }
+    ch->written = 0U;
+    ch->published = 0U;
+    ch->reading = 0U;
+    ch->size = size;
+}
+
+void channel_write(channel_t *ch, void const *msg) {
+    uint8_t const *src = (uint8_t const *)msg;
+    uint8_t published = ch->published;
+    uint8_t reading = ch->reading;
+    uint8_t slot = 0U;
+
+    /* the reader only ever claims the published slot, so it can't take
+    * this one before it is published below
+    */
+    while ((slot == published) || (slot == reading)) {
+        ++slot;
+    }
+    for (uint8_t i = 0U; i < ch->size; ++i) {
+        ch->data[slot][i] = src[i];
+    }
+    ch->number[slot] = ++ch->written;
+
+    OS_COMPILER_BARRIER();
+    ch->published = slot;
+}
+
+uint32_t channel_read(channel_t *ch, void *msg) {
+    uint8_t *dst = (uint8_t *)msg;
+    uint8_t slot;
+
+    /* claim the published slot; a write that published in between may
+    * have started on the slot claimed before, so claim again
+    */
+    do {
+        slot = ch->published;
+        ch->reading = slot;
+        OS_COMPILER_BARRIER();
+    } while (slot != ch->published);
+
+    if (ch->number[slot] != 0U) {
+        for (uint8_t i = 0U; i < ch->size; ++i) {
+            dst[i] = ch->data[slot][i];
+        }
+    }
+    return ch->number[slot];
+}
+
+static void OS_task_insert(OSThread *me);
+
 // Start a aperiodic task
 void OSAperiodic_task_start(OSThread *me,
     OSThreadHandler threadHandler,
     void *stkSto, uint32_t stkSize){
 
-	__disable_irq();
+    /* a job without a declared cost is taken as one full server capacity */
+    OSAperiodic_job_start(me, threadHandler, stkSto, stkSize, 0U);
+}
 
-    uint32_t *sp = (uint32_t *)((((uint32_t)stkSto + stkSize) / 8) * 8);
-    uint32_t *stk_limit;
+void OSAperiodic_job_start(OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize,
+    uint32_t cost){
 
-    /* number of aperiodic tasks must be lower or equal to array with its parameters */
-    Q_REQUIRE((number_aperiodic_tasks+1 < NUM_MAX_APERIODIC_TASKS));
+    uint8_t tail;
 
-    *(--sp) = (1U << 24);  /* xPSR */
-    *(--sp) = (uint32_t)threadHandler; /* PC */
-    *(--sp) = 0x0000000EU; /* LR  */
-    *(--sp) = 0x0000000CU; /* R12 */
-    *(--sp) = 0x00000003U; /* R3  */
-    *(--sp) = 0x00000002U; /* R2  */
-    *(--sp) = 0x00000001U; /* R1  */
-    *(--sp) = 0x00000000U; /* R0  */
-    /* additionally, fake registers R4-R11 */
-    *(--sp) = 0x0000000BU; /* R11 */
-    *(--sp) = 0x0000000AU; /* R10 */
-    *(--sp) = 0x00000009U; /* R9 */
-    *(--sp) = 0x00000008U; /* R8 */
-    *(--sp) = 0x00000007U; /* R7 */
-    *(--sp) = 0x00000006U; /* R6 */
-    *(--sp) = 0x00000005U; /* R5 */
-    *(--sp) = 0x00000004U; /* R4 */
+    /* build the initial stack frame / context of the thread, which is
+    * not queued yet (a job must not be started again before it finished)
+    */
+    OS_port_thread_init(me, threadHandler, stkSto, stkSize);
 
-    /* save the top of the stack in the thread's attibute */
-    me->sp = sp;
+    /* an aperiodic job only runs at the head of the queue, as priority 0 */
+    me->prio = 0U;
+    me->critical_regions_historic[0] = 0U;
 
-    /* round up the bottom of the stack to the 8-byte boundary */
-    stk_limit = (uint32_t *)(((((uint32_t)stkSto - 1U) / 8) + 1U) * 8);
+	__disable_irq();
+    tail = OS_aperiodicTail;
 
-    /* pre-fill the unused part of the stack with 0xDEADBEEF */
-    for (sp = sp - 1U; sp >= stk_limit; --sp) {
-        *sp = 0xDEADBEEFU;
-    }
+    /* the queue must have a free slot */
+    Q_REQUIRE(OS_APERIODIC_NEXT(tail) != OS_aperiodicHead);
 
-    OS_aperiodic_tasks[number_aperiodic_tasks] = me;
-    OS_aperiodic_tasks[number_aperiodic_tasks]->prio = number_aperiodic_tasks;
-    OS_aperiodic_tasks[number_aperiodic_tasks]->critical_regions_historic[0] = number_aperiodic_tasks;
+    /* TBS: d_k = max(r_k, d_k-1) + C_k * T_s / Q_s, rounded up */
+    if (OS_serverPolicy == OS_SERVER_TBS) {
+        uint32_t from = OS_tickCtr;
 
-    number_aperiodic_tasks++;
+        if (cost == 0U) {
+            cost = OS_serverCapacity;
+        }
+        if ((int32_t)(OS_serverLastDeadline - from) > 0) {
+            from = OS_serverLastDeadline;
+        }
+        OS_serverLastDeadline = from
+            + (cost * OS_serverParameters.period_absolute + OS_serverCapacity - 1U)
+              / OS_serverCapacity;
+        OS_aperiodicDeadline[tail] = OS_serverLastDeadline;
+    }
 
+    OS_aperiodic_tasks[tail] = me;
+    OS_aperiodicTail = OS_APERIODIC_NEXT(tail);
     __enable_irq();
+
+    /* a deferrable server with capacity left serves the arrival at once,
+    * an idle bandwidth server is activated. Before OS_run the server is
+    * not placed yet, OS_run activates it
+    */
+    if ((OS_serverPolicy == OS_SERVER_DEFERRABLE) || OS_SERVER_BANDWIDTH()) {
+        __disable_irq();
+        if ((OS_deadlineInfoOf[OS_serverThread.prio - 1U] == (OSThread_deadline_info *)0)
+            || ((OS_readySet & (1U << (OS_serverThread.prio - 1U))) != 0U)) {
+            /* not running yet, or already serving the queue */
+        } else if (OS_serverPolicy == OS_SERVER_DEFERRABLE) {
+            if (OS_serverBudget != 0U) {
+                OS_ready_insert(OS_serverThread.prio);
+                OS_sched();
+            }
+        } else {
+            OS_server_activate();
+            OS_sched();
+        }
+        __enable_irq();
+    }
 }
 
 void OSPeriodic_task_start(
@@ -351,50 +1316,34 @@ void OSPeriodic_task_start(
     OSThreadHandler threadHandler,
     void *stkSto, uint32_t stkSize) {
 
-    /* round down the stack top to the 8-byte boundary
-    * NOTE: ARM Cortex-M stack grows down from hi -> low memory
-    */
-    uint32_t *sp = (uint32_t *)((((uint32_t)stkSto + stkSize) / 8) * 8);
-    uint32_t *stk_limit;
-
     /* priority must be in range of periodic tasks in array
     * and the priority level must be unused
     */
     Q_REQUIRE((number_periodic_tasks+1 < Q_DIM(OS_tasks)-1)
               && (OS_tasks[number_periodic_tasks+1] == (OSThread *)0));
 
-    if (threadHandler != &main_idleThread)
-        number_periodic_tasks++;
+    if (threadHandler != &main_idleThread) {
+        OSThread_deadline_info *info = &OS_deadlineInfo[number_periodic_tasks];
 
-    *(--sp) = (1U << 24);  /* xPSR */
-    *(--sp) = (uint32_t)threadHandler; /* PC */
-    *(--sp) = 0x0000000EU; /* LR  */
-    *(--sp) = 0x0000000CU; /* R12 */
-    *(--sp) = 0x00000003U; /* R3  */
-    *(--sp) = 0x00000002U; /* R2  */
-    *(--sp) = 0x00000001U; /* R1  */
-    *(--sp) = 0x00000000U; /* R0  */
-    /* additionally, fake registers R4-R11 */
-    *(--sp) = 0x0000000BU; /* R11 */
-    *(--sp) = 0x0000000AU; /* R10 */
-    *(--sp) = 0x00000009U; /* R9 */
-    *(--sp) = 0x00000008U; /* R8 */
-    *(--sp) = 0x00000007U; /* R7 */
-    *(--sp) = 0x00000006U; /* R6 */
-    *(--sp) = 0x00000005U; /* R5 */
-    *(--sp) = 0x00000004U; /* R4 */
-
-    /* save the top of the stack in the thread's attibute */
-    me->sp = sp;
-
-    /* round up the bottom of the stack to the 8-byte boundary */
-    stk_limit = (uint32_t *)(((((uint32_t)stkSto - 1U) / 8) + 1U) * 8);
-
-    /* pre-fill the unused part of the stack with 0xDEADBEEF */
-    for (sp = sp - 1U; sp >= stk_limit; --sp) {
-        *sp = 0xDEADBEEFU;
+        number_periodic_tasks++;
+        info->thread = me;
+        info->threadHandler = threadHandler;
+        info->stkSto = stkSto;
+        info->stkSize = stkSize;
     }
 
+    /* build the initial stack frame / context of the thread */
+    OS_port_thread_init(me, threadHandler, stkSto, stkSize);
+
+    OS_task_insert(me);
+
+    /* the thread is registered with the OS and made ready to run
+    * by OS_run, once all the priorities are known
+    */
+}
+
+/* put a task counted in number_periodic_tasks in OS_tasks, by deadline */
+static void OS_task_insert(OSThread *me) {
     // If is the Idle Thread
     if (number_periodic_tasks == 0){
         OS_tasks[0] = me;
@@ -431,55 +1380,197 @@ void OSPeriodic_task_start(
             }
         }
     }
+}
+
+void OS_server_start(OS_server_policy policy, uint32_t capacity, uint32_t period) {
+    OSThread_deadline_info *info;
+
+    /* one server, a capacity that fits in its period, and a free slot */
+    Q_REQUIRE((OS_serverPolicy == OS_SERVER_BACKGROUND)
+#ifdef MIROS_EDF
+              && (policy <= OS_SERVER_CBS)
+#else
+              && (policy <= OS_SERVER_DEFERRABLE)
+#endif
+              && ((policy == OS_SERVER_BACKGROUND)
+                  || ((capacity != 0U) && (capacity <= period)))
+              && ((uint32_t)number_periodic_tasks + 1U < Q_DIM(OS_tasks) - 1U));
+
+    if (policy == OS_SERVER_BACKGROUND) {
+        return;
+    }
+    OS_serverPolicy = policy;
+    OS_serverCapacity = capacity;
+    OS_serverParameters.period_absolute = period;
+    OS_serverParameters.period_dinamic = period;
+    OS_serverParameters.deadline_absolute = period;
+    OS_serverParameters.deadline_dinamic = period;
+    OS_serverThread.task_parameters = &OS_serverParameters;
+
+    /* counted as a periodic task, without a thread to restart */
+    info = &OS_deadlineInfo[number_periodic_tasks];
+    number_periodic_tasks++;
+    info->thread = &OS_serverThread;
+
+    OS_task_insert(&OS_serverThread);
+}
+
+static OSThread_deadline_info *OS_deadline_info_find(OSThread const *me) {
+    for (uint8_t i = 0U; i < number_periodic_tasks; i++) {
+        if (OS_deadlineInfo[i].thread == me) {
+            return &OS_deadlineInfo[i];
+        }
+    }
+    return (OSThread_deadline_info *)0;
+}
+
+void OS_deadline_policy_set(OSThread *me,
+    OS_deadline_policy policy,
+    OS_deadlineHandler handler) {
+
+    OSThread_deadline_info *info;
+    __disable_irq();
+
+    info = OS_deadline_info_find(me);
+
+    /* only a started periodic task has a deadline, and a callback needs a handler */
+    Q_REQUIRE((info != (OSThread_deadline_info *)0)
+              && ((policy != OS_DEADLINE_CALLBACK) || (handler != (OS_deadlineHandler)0)));
+
+    info->policy = policy;
+    info->handler = handler;
+    __enable_irq();
+}
+
+/* the record of the running thread, (OSThread_deadline_info *)0 for the
+* idle thread, an aperiodic job or before OS_run
+*/
+static OSThread_deadline_info *OS_deadline_info_curr(void) {
+    OSThread *me = OS_curr; /* read the volatile pointer once */
+
+    if ((me == (OSThread *)0) || (me->prio == 0U)
+        || (me->prio > number_periodic_tasks)) {
+        return (OSThread_deadline_info *)0;
+    }
+    return OS_deadlineInfoOf[me->prio - 1U];
+}
+
+void OS_deadline_abort_hold(void) {
+    OSThread_deadline_info *info;
+    __disable_irq();
+
+    info = OS_deadline_info_curr();
+    if (info != (OSThread_deadline_info *)0) {
+        Q_REQUIRE(info->abortHold < 0xFFU);
+        info->abortHold++;
+    }
+    __enable_irq();
+}
+
+void OS_deadline_abort_release(void) {
+    OSThread_deadline_info *info;
+    __disable_irq();
+
+    info = OS_deadline_info_curr();
+    if (info != (OSThread_deadline_info *)0) {
+        Q_REQUIRE(info->abortHold != 0U);
+        info->abortHold--;
+    }
+    __enable_irq();
+}
+
+OSThread_deadline_stats const *OS_deadline_stats_get(OSThread const *me) {
+    OSThread_deadline_info *info = OS_deadline_info_find(me);
+
+    if (info == (OSThread_deadline_info *)0) {
+        return (OSThread_deadline_stats *)0;
+    }
+    return &info->stats;
+}
+
+void mutex_use(mutex_t *m, OSThread *user) {
+    OSThread_deadline_info *info = OS_deadline_info_find(user);
 
-    /* register the thread with the OS */
-    /* make the thread ready to run */
-    if (me->prio > 0U) {
-        OS_readySet |= (1U << (me->prio - 1U));
+    /* only a started periodic or sporadic task has a priority */
+    Q_REQUIRE((info != (OSThread_deadline_info *)0) && (user != &OS_serverThread));
+
+    if (m->users == 0U) {
+        m->next = OS_mutexList;
+        OS_mutexList = m;
     }
+    m->users |= (1U << (info - OS_deadlineInfo));
 }
 
-__attribute__ ((naked, optimize("-fno-stack-protector")))
-void PendSV_Handler(void) {
-__asm volatile (
+void OSSporadic_task_start(
+    OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize) {
+
+    OSPeriodic_task_start(me, threadHandler, stkSto, stkSize);
+    OS_deadline_info_find(me)->sporadic = 1U;
+}
 
-    /* __disable_irq(); */
-    "  CPSID         I                 \n"
+void OS_sporadic_release(OSThread *me) {
+    __disable_irq();
+
+    Q_REQUIRE((me->prio != 0U) && (OS_tasks[me->prio] == me));
+
+    if ((OS_sporadicSet & (1U << (me->prio - 1U))) != 0U) {
+        if (OS_sporadic_arrival(me->prio)) {
+            OS_sched();
+        }
+    } else {
+        /* before OS_run, the first job is released by OS_run */
+        OS_deadline_info_find(me)->arrivedEarly = 1U;
+    }
+    __enable_irq();
+}
 
-    /* if (OS_curr != (OSThread *)0) { */
-    "  LDR           r1,=OS_curr       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  CBZ           r1,PendSV_restore \n"
+void OS_chain_link(OSThread *pred, OSThread *succ) {
+    OSThread_deadline_info *from = OS_deadline_info_find(pred);
+    OSThread_deadline_info *to = OS_deadline_info_find(succ);
 
-    /*     push registers r4-r11 on the stack */
-    "  PUSH          {r4-r11}          \n"
+    /* two started tasks, a sporadic successor, no branch */
+    Q_REQUIRE((from != (OSThread_deadline_info *)0) && (to != (OSThread_deadline_info *)0)
+              && (pred != &OS_serverThread) && to->sporadic
+              && (from->chainNext == (OSThread *)0) && !to->chained);
 
-    /*     OS_curr->sp = sp; */
-    "  LDR           r1,=OS_curr       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  STR           sp,[r1,#0x00]     \n"
-    /* } */
+    /* and no loop back to the predecessor */
+    for (OSThread *t = succ; t != (OSThread *)0; t = OS_deadline_info_find(t)->chainNext) {
+        Q_REQUIRE(t != pred);
+    }
 
-    "PendSV_restore:                   \n"
-    /* sp = OS_next->sp; */
-    "  LDR           r1,=OS_next       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  LDR           sp,[r1,#0x00]     \n"
+    from->chainNext = succ;
+    to->chained = 1U;
+}
 
-    /* OS_curr = OS_next; */
-    "  LDR           r1,=OS_next       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  LDR           r2,=OS_curr       \n"
-    "  STR           r1,[r2,#0x00]     \n"
+OS_chain_stats const *OS_chain_stats_get(OSThread const *tail) {
+    OSThread_deadline_info *info = OS_deadline_info_find(tail);
 
-    /* pop registers r4-r11 */
-    "  POP           {r4-r11}          \n"
+    if ((info == (OSThread_deadline_info *)0) || !info->chained
+        || (info->chainNext != (OSThread *)0)) {
+        return (OS_chain_stats *)0;
+    }
+    return &info->chainStats;
+}
 
-    /* __enable_irq(); */
-    "  CPSIE         I                 \n"
+#ifdef MIROS_TRACE
+OSThread_trace_stats const *OS_trace_stats_get(OSThread const *me) {
+    uint8_t prio = OS_trace_bit_of(me);
 
-    /* return to the next thread */
-    "  BX            lr                \n"
-    );
+    if (prio == 0U) {
+        return (OSThread_trace_stats *)0;
+    }
+    return &OS_traceStats[prio - 1U];
 }
 
+OS_trace_stat const *OS_chain_trace_get(OSThread const *tail) {
+    OSThread_deadline_info *info = OS_deadline_info_find(tail);
+
+    if ((info == (OSThread_deadline_info *)0) || !info->chained
+        || (info->chainNext != (OSThread *)0)) {
+        return (OS_trace_stat *)0;
+    }
+    return &info->chainTrace;
+}
+#endif /* MIROS_TRACE */
@@ -0,0 +1,195 @@
+/****************************************************************************
+* MiROS port to ARM Cortex-M3 (STM32F103), GNU-ARM.
+*
+* Context switch in the PendSV exception, threads run on the MSP.
+* See miros_port.h for the interface used by the kernel.
+****************************************************************************/
+#include <stdint.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "stm32f1xx_hal.h"
+
+void OS_port_init(void) {
+    /* set the PendSV interrupt priority to the lowest level 0xFF */
+    *(uint32_t volatile *)0xE000ED20 |= (0xFFU << 16);
+
+#ifdef MIROS_TRACE
+    /* start the DWT cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+#ifdef MIROS_TRACE
+uint32_t OS_port_cycles(void) {
+    return DWT->CYCCNT;
+}
+#endif
+
+void OS_port_thread_init(OSThread *me,
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize) {
+
+    /* round down the stack top to the 8-byte boundary
+    * NOTE: ARM Cortex-M stack grows down from hi -> low memory
+    */
+    uint32_t *sp = (uint32_t *)((((uint32_t)stkSto + stkSize) / 8) * 8);
+    uint32_t *stk_limit;
+
+    *(--sp) = (1U << 24);  /* xPSR */
+    *(--sp) = (uint32_t)threadHandler; /* PC */
+    *(--sp) = 0x0000000EU; /* LR  */
+    *(--sp) = 0x0000000CU; /* R12 */
+    *(--sp) = 0x00000003U; /* R3  */
+    *(--sp) = 0x00000002U; /* R2  */
+    *(--sp) = 0x00000001U; /* R1  */
+    *(--sp) = 0x00000000U; /* R0  */
+    /* additionally, fake registers R4-R11 */
+    *(--sp) = 0x0000000BU; /* R11 */
+    *(--sp) = 0x0000000AU; /* R10 */
+    *(--sp) = 0x00000009U; /* R9 */
+    *(--sp) = 0x00000008U; /* R8 */
+    *(--sp) = 0x00000007U; /* R7 */
+    *(--sp) = 0x00000006U; /* R6 */
+    *(--sp) = 0x00000005U; /* R5 */
+    *(--sp) = 0x00000004U; /* R4 */
+
+    /* save the top of the stack in the thread's attibute */
+    me->sp = sp;
+
+    /* round up the bottom of the stack to the 8-byte boundary */
+    stk_limit = (uint32_t *)(((((uint32_t)stkSto - 1U) / 8) + 1U) * 8);
+
+    /* pre-fill the unused part of the stack with 0xDEADBEEF */
+    for (sp = sp - 1U; sp >= stk_limit; --sp) {
+        *sp = 0xDEADBEEFU;
+    }
+}
+
+void OS_port_context_switch(void) {
+    /* trigger PendSV */
+    //*(uint32_t volatile *)0xE000ED04 = (1U << 28);
+    SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+    __asm volatile("dsb");
+//    __asm volatile("isb");
+    /*
+     * DSB - whenever a memory access needs to have completed before program execution progresses.
+     * ISB - whenever instruction fetches need to explicitly take place after a certain point in the program,
+     * for example after memory map updates or after writing code to be executed.
+     * (In practice, this means "throw away any prefetched instructions at this point".)
+     * */
+}
+
+#ifdef MIROS_TICKLESS
+uint32_t OS_port_sleep(uint32_t ticks) {
+    uint32_t reload = SystemCoreClock / TICKS_PER_SEC; /* as in OS_onStartup() */
+    /* the 24-bit counter holds 2^24 / reload ticks: 2097 with the board's
+    * 8 MHz HSI and the 1 ms tick (TICKS_PER_SEC 1000) */
+    uint32_t maxTicks = (SysTick_LOAD_RELOAD_Msk + 1U) / reload;
+    uint32_t remaining, elapsed, skipped, ctrl;
+
+    if (ticks > maxTicks) {
+        ticks = maxTicks;
+    }
+    if (ticks < 2U) {
+        /* the next tick is the event, a plain WFI does it */
+        __DSB();
+        __WFI();
+        __ISB();
+        return 0U;
+    }
+
+    /* stretch the current tick over the whole sleep */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    remaining = SysTick->VAL;
+    SysTick->LOAD = remaining + ((ticks - 1U) * reload) - 1U;
+    SysTick->VAL = 0U;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    /* PRIMASK is set: any interrupt wakes the core but stays pending */
+    __DSB();
+    __WFI();
+    __ISB();
+
+    /* reading CTRL clears COUNTFLAG, read it once */
+    ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+
+    if ((ctrl & SysTick_CTRL_COUNTFLAG_Msk) != 0U) {
+        /* slept to the event, its SysTick interrupt is pending */
+        skipped = ticks - 1U;
+        SysTick->LOAD = reload - 1U;
+    } else {
+        /* woken earlier, finish the tick in progress on time */
+        elapsed = (reload - remaining) + (SysTick->LOAD - SysTick->VAL);
+        skipped = elapsed / reload;
+        remaining = reload - (elapsed % reload);
+        if (remaining < 2U) {
+            /* a LOAD of 0 never fires, raise that tick by hand */
+            SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+            remaining = reload;
+        }
+        SysTick->LOAD = remaining - 1U;
+    }
+    SysTick->VAL = 0U;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = reload - 1U; /* used from the next reload on */
+
+    for (uint32_t i = 0U; i < skipped; i++) {
+        HAL_IncTick();
+    }
+    return skipped;
+}
+#endif /* MIROS_TICKLESS */
+
+__attribute__ ((naked, optimize("-fno-stack-protector")))
+void PendSV_Handler(void) {
+__asm volatile (
+
+    /* __disable_irq(); */
+    "  CPSID         I                 \n"
+
+#ifdef MIROS_TRACE
+    /* OS_trace_switch(); r0-r3 and r12 are stacked, keep EXC_RETURN */
+    "  PUSH          {r0,lr}           \n"
+    "  BL            OS_trace_switch   \n"
+    "  POP           {r0,lr}           \n"
+#endif
+
+    /* if (OS_curr != (OSThread *)0) { */
+    "  LDR           r1,=OS_curr       \n"
+    "  LDR           r1,[r1,#0x00]     \n"
+    "  CBZ           r1,PendSV_restore \n"
+
+    /*     push registers r4-r11 on the stack */
+    "  PUSH          {r4-r11}          \n"
+
+    /*     OS_curr->sp = sp; */
+    "  LDR           r1,=OS_curr       \n"
+    "  LDR           r1,[r1,#0x00]     \n"
+    "  STR           sp,[r1,#0x00]     \n"
+    /* } */
+
+    "PendSV_restore:                   \n"
+    /* sp = OS_next->sp; */
+    "  LDR           r1,=OS_next       \n"
+    "  LDR           r1,[r1,#0x00]     \n"
+    "  LDR           sp,[r1,#0x00]     \n"
+
+    /* OS_curr = OS_next; */
+    "  LDR           r1,=OS_next       \n"
+    "  LDR           r1,[r1,#0x00]     \n"
+    "  LDR           r2,=OS_curr       \n"
+    "  STR           r1,[r2,#0x00]     \n"
+
+    /* pop registers r4-r11 */
+    "  POP           {r4-r11}          \n"
+
+    /* __enable_irq(); */
+    "  CPSIE         I                 \n"
+
+    /* return to the next thread */
+    "  BX            lr                \n"
+    );
+}
@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include "pid_batch.h"
+#include "qassert.h"
+
+Q_DEFINE_THIS_FILE
+
+void PID_batch_init(PIDBatch *batch, float period) {
+    Q_ASSERT(batch);
+    Q_REQUIRE(period > 0.0f);
+
+    batch->period = period;
+    batch->count = 0U;
+}
+
+uint32_t PID_batch_add(PIDBatch *batch, PIDController const *controller) {
+    uint32_t i;
+
+    Q_ASSERT(batch && controller);
+
+    i = batch->count;
+    Q_REQUIRE(i < PID_BATCH_MAX);
+
+    batch->Kp[i] = controller->Kp;
+    batch->Ki[i] = controller->Ki;
+    batch->Kd[i] = controller->Kd;
+    batch->integral_sum[i] = controller->integral_sum;
+    batch->error_prev[i] = controller->error_prev;
+    batch->max[i] = controller->max;
+    batch->min[i] = controller->min;
+    batch->count = i + 1U;
+
+    return i;
+}
+
+void PID_batch_action(PIDBatch *batch, float const *restrict error,
+                      float *restrict output) {
+    float *restrict integral_sum = batch->integral_sum;
+    float *restrict error_prev = batch->error_prev;
+    float const *restrict kp = batch->Kp;
+    float const *restrict ki = batch->Ki;
+    float const *restrict kd = batch->Kd;
+    float const *restrict max = batch->max;
+    float const *restrict min = batch->min;
+    float const period = batch->period;
+    uint32_t const count = batch->count;
+
+    /* PID_action() with the clamps as min/max (minps/maxps on the host) */
+    for (uint32_t i = 0U; i < count; ++i) {
+        float e = error[i];
+        float sum = integral_sum[i] + (e * period);
+        float derivative_term = (e - error_prev[i]) / period;
+        float u = (kp[i] * e) + (ki[i] * sum) + (kd[i] * derivative_term);
+
+        u = (max[i] < u) ? max[i] : u;
+        u = (u < min[i]) ? min[i] : u;
+
+        integral_sum[i] = sum;
+        error_prev[i] = e;
+        output[i] = u;
+    }
+}
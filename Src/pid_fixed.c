@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include "pid_fixed.h"
+#include "qassert.h"
+
+Q_DEFINE_THIS_FILE
+
+#define PID_TERM_MAX ((int64_t)1 << 61)
+
+static q31_t pid_sat31(int64_t x) {
+    if (x > Q31_MAX) {
+        return Q31_MAX;
+    }
+    if (x < Q31_MIN) {
+        return Q31_MIN;
+    }
+    return (q31_t)x;
+}
+
+static float pid_abs(float x) {
+    return (x < 0.0f) ? -x : x;
+}
+
+/* x * 2^(31 + shift), rounded to nearest */
+static q31_t pid_coef(float x, uint8_t shift) {
+    double scaled = (double)x * 2147483648.0 * (double)(1UL << shift);
+    return pid_sat31((int64_t)((scaled < 0.0) ? (scaled - 0.5) : (scaled + 0.5)));
+}
+
+/* c * x / 2^shift, c in Q31 scaled by 2^shift: the term in Q31, kept
+* within +-2^61 so that the sum of three terms cannot overflow
+*/
+static int64_t pid_term(q31_t c, int32_t x, uint8_t shift) {
+    int64_t term = ((int64_t)c * x) >> shift;
+
+    if (term > PID_TERM_MAX) {
+        return PID_TERM_MAX;
+    }
+    if (term < -PID_TERM_MAX) {
+        return -PID_TERM_MAX;
+    }
+    return term;
+}
+
+void PID_fixed_setup(PIDController_fixed *controller, float kp, float ki, float kd,
+                     float period, int32_t setpoint, float max, float min) {
+    float ki_t = ki * period;
+    float kd_t = kd / period;
+    float largest = pid_abs(kp);
+    uint8_t shift = 0U;
+
+    Q_ASSERT(controller);
+    Q_REQUIRE((period > 0.0f) && (min <= max));
+
+    if (pid_abs(ki_t) > largest) {
+        largest = pid_abs(ki_t);
+    }
+    if (pid_abs(kd_t) > largest) {
+        largest = pid_abs(kd_t);
+    }
+    Q_REQUIRE(largest < 1.0f);
+
+    /* as much precision as the largest coefficient allows */
+    while ((shift < 31U) && (largest != 0.0f) && (largest * 2.0f < 1.0f)) {
+        largest *= 2.0f;
+        shift++;
+    }
+
+    controller->kp = pid_coef(kp, shift);
+    controller->ki_t = pid_coef(ki_t, shift);
+    controller->kd_t = pid_coef(kd_t, shift);
+    controller->shift = shift;
+    controller->setpoint = setpoint;
+    controller->input = 0;
+    controller->error_sum = 0;
+    controller->error_prev = 0;
+    controller->max = pid_sat31((int64_t)((double)max * 2147483648.0));
+    controller->min = pid_sat31((int64_t)((double)min * 2147483648.0));
+}
+
+q31_t PID_fixed_action(PIDController_fixed *controller, int32_t error) {
+    int64_t output;
+
+    Q_ASSERT(controller);
+
+    controller->error_sum = pid_sat31((int64_t)controller->error_sum + error);
+
+    /* the terms may cancel, so they are summed before the clamp to [min, max] */
+    output = pid_term(controller->kp, error, controller->shift);
+    output += pid_term(controller->ki_t, controller->error_sum, controller->shift);
+    output += pid_term(controller->kd_t,
+                       pid_sat31((int64_t)error - controller->error_prev),
+                       controller->shift);
+
+    controller->error_prev = error;
+
+    if (output > controller->max) {
+        output = controller->max;
+    }
+    if (output < controller->min) {
+        output = controller->min;
+    }
+
+    return (q31_t)output;
+}
+
+/* x * 2^31 in float, exact for a power of two, so the soft-float core
+* does a single float multiply and no double conversion
+*/
+q31_t PID_fixed_from_float(float x) {
+    float scaled = x * 2147483648.0f;
+
+    if (scaled >= 2147483648.0f) {
+        return Q31_MAX;
+    }
+    if (scaled < -2147483648.0f) {
+        return Q31_MIN;
+    }
+    return (q31_t)scaled;
+}
@@ -0,0 +1,27 @@
+#include <stdint.h>
+#include "pid_schedule.h"
+
+#define PID_SCHEDULE_LAST ((int32_t)(((PID_SCHEDULE_POINTS - 1U) << PID_SCHEDULE_STEP_BITS) - 1U))
+#define PID_SCHEDULE_MASK ((1U << PID_SCHEDULE_STEP_BITS) - 1U)
+
+/* branch-free, as conditional selects */
+static inline int64_t pid_clamp(int64_t x, int64_t lo, int64_t hi) {
+    x = (x < lo) ? lo : x;
+    return (x > hi) ? hi : x;
+}
+
+/* table[i] + (table[i + 1] - table[i]) * fraction / 2^PID_SCHEDULE_STEP_BITS */
+static inline int32_t pid_schedule_lerp(q31_t const *table, uint32_t i, int32_t fraction) {
+    return table[i] + (int32_t)(((int64_t)(table[i + 1U] - table[i]) * fraction)
+                                >> PID_SCHEDULE_STEP_BITS);
+}
+
+q31_t PID_schedule_apply(int32_t distance, q31_t output) {
+    int32_t d = (int32_t)pid_clamp(distance, 0, PID_SCHEDULE_LAST);
+    uint32_t i = (uint32_t)d >> PID_SCHEDULE_STEP_BITS;
+    int32_t fraction = (int32_t)((uint32_t)d & PID_SCHEDULE_MASK);
+    int64_t bias = pid_schedule_lerp(pid_schedule_bias, i, fraction);
+    int64_t scale = pid_schedule_lerp(pid_schedule_scale, i, fraction);
+
+    return (q31_t)pid_clamp(bias + ((scale * output) >> 30), 0, Q31_MAX);
+}
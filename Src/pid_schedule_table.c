@@ -0,0 +1,34 @@
+/* Generated by Host/gen_schedule.c from Host/schedules/fan_hover.txt, reference 0.61,
+* do not edit */
+#include <stdint.h>
+#include "pid_schedule.h"
+
+/* hover duty */
+q31_t const pid_schedule_bias[PID_SCHEDULE_POINTS] = {
+    1309965025, /*   0 mm: 0.6100 */
+    1309965025, /*  64 mm: 0.6100 */
+    1309965025, /* 128 mm: 0.6100 */
+    1309965025, /* 192 mm: 0.6100 */
+    1309965025, /* 256 mm: 0.6100 */
+    1309965025, /* 320 mm: 0.6100 */
+    1309965025, /* 384 mm: 0.6100 */
+    1309965025, /* 448 mm: 0.6100 */
+    1309965025, /* 512 mm: 0.6100 */
+    1309965025, /* 576 mm: 0.6100 */
+    1309965025, /* 640 mm: 0.6100 */
+};
+
+/* hover duty / reference */
+q31_t const pid_schedule_scale[PID_SCHEDULE_POINTS] = {
+    1073741824, /*   0 mm: 1.0000 */
+    1073741824, /*  64 mm: 1.0000 */
+    1073741824, /* 128 mm: 1.0000 */
+    1073741824, /* 192 mm: 1.0000 */
+    1073741824, /* 256 mm: 1.0000 */
+    1073741824, /* 320 mm: 1.0000 */
+    1073741824, /* 384 mm: 1.0000 */
+    1073741824, /* 448 mm: 1.0000 */
+    1073741824, /* 512 mm: 1.0000 */
+    1073741824, /* 576 mm: 1.0000 */
+    1073741824, /* 640 mm: 1.0000 */
+};
@@ -0,0 +1,43 @@
+#include <stdint.h>
+#include "pwm_dither.h"
+#include "qassert.h"
+
+Q_DEFINE_THIS_FILE
+
+void pwm_dither_init(pwm_dither *pwm, uint16_t *ccr, uint32_t stride, uint32_t arr) {
+    Q_ASSERT(pwm && ccr);
+    Q_REQUIRE((stride != 0U) && (arr < 0xFFFFU)); /* 16-bit CCR, 100% is ARR + 1 */
+
+    pwm->ccr = ccr;
+    pwm->stride = stride;
+    pwm->counts = arr + 1U;
+    pwm->residue = 0U;
+    for (uint32_t i = 0U; i < PWM_DITHER_PERIODS; ++i) {
+        ccr[i * stride] = 0U;
+    }
+}
+
+void pwm_dither_set(pwm_dither *pwm, q31_t duty) {
+    uint64_t compare;
+    uint32_t whole;
+    uint32_t fraction;
+    uint32_t residue = pwm->residue;
+    uint16_t *ccr = pwm->ccr;
+
+    if (duty < 0) {
+        duty = 0;
+    }
+    /* duty * (ARR + 1) in counts, with 31 fractional bits */
+    compare = (uint64_t)(uint32_t)duty * pwm->counts;
+    whole = (uint32_t)(compare >> 31);
+    fraction = (uint32_t)compare << 1;
+
+    for (uint32_t i = 0U; i < PWM_DITHER_PERIODS; ++i) {
+        uint32_t sum = residue + fraction;
+
+        *ccr = (uint16_t)(whole + (sum < residue)); /* carry out */
+        ccr += pwm->stride;
+        residue = sum;
+    }
+    pwm->residue = residue;
+}